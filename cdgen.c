@@ -0,0 +1,1233 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "cdgen_int.h"
+
+/* Time spent and bytes produced, see cd_engine_report() */
+typedef struct
+{
+  size_t count;
+  size_t bytes;
+  double seconds;
+} cd_stat_t;
+
+/* Rendered period, keyed by the generator parameters */
+typedef struct cd_period
+{
+  struct cd_period *next;
+  cd_track_t key;
+  size_t len;
+  sample_t *sam;
+  void *map;			// Cache file mapping sam points into, NULL if allocated
+  size_t map_len;
+  size_t refs;			// Tracks rendering from it right now
+} cd_period_t;
+
+struct cd_engine
+{
+  cd_options_t opt;
+  cd_pool_t *pool;		// NULL when rendering in order
+  pthread_mutex_t lock;		// Guards periods
+  cd_period_t *periods;		// Most recently used first
+  size_t periods_max;		// Bytes kept between tracks
+  cd_stat_t stats[CD_GEN_NUM];	// Per generator, guarded by lock
+  cd_stat_t images;		// Whole images, open to close
+  size_t cache_hits;		// Periods mapped from the cache, guarded by lock
+  size_t cache_misses;		// Periods rendered and stored
+};
+
+/* Image range rendered by one job, a whole track or a block of a random access one */
+typedef struct
+{
+  size_t ti;
+  size_t begin;
+  size_t end;
+  int keep;			// Unchanged by an incremental build, only read back for the manifest
+} cd_piece_t;
+
+/* One disc being rendered, pieces are handed out in order */
+typedef struct
+{
+  cd_engine_t *engine;
+  const cd_plan_t *plan;
+  cd_image_t img[CD_FORMAT_MAX];	// One per format
+  char *img_name[CD_FORMAT_MAX];
+  const cd_format_t *img_fmt[CD_FORMAT_MAX];
+  size_t img_num;
+  cd_piece_t *pieces;
+  char *manifest_name;
+  char *accurip_name;
+  cd_digest_t *digests;		// Per image, of the whole image then each track, NULL if not hashing
+} cd_job_t;
+
+static const size_t periods_max_default = 64U << 20;
+static const size_t piece_len = 2U * CD_SINK_BLOCK / 4U;	// Samples per block of a random access track
+
+static int engine_open (cd_engine_t * engine, cd_job_t * job, const char *base_name, size_t data_size, int update);
+static int engine_accurip (cd_job_t * job, size_t data_size);
+static int engine_verify (cd_engine_t * engine, cd_job_t * job, size_t data_size);
+static uint8_t *engine_changed (cd_engine_t * engine, const cd_plan_t * plan, const char *build_name);
+static int engine_hasher (const cd_plan_t * plan, cd_image_t * img);
+static int engine_close (cd_job_t * job, const char *base_name, int ret);
+static int engine_reread (cd_job_t * job, const cd_piece_t * piece);
+static size_t engine_pieces (const cd_engine_t * engine, const cd_plan_track_t * pt);
+static int engine_job (void *arg, size_t i);
+static int write_track (cd_engine_t * engine, const cd_plan_track_t * pt, const int trk_i, cd_sink_t * sink, size_t end);
+static int write_track_data (cd_engine_t * engine, const cd_gen_t * gen, const cd_plan_track_t * pt, const int trk_i, cd_sink_t * sink, size_t end);
+static int write_track_at (const cd_gen_t * gen, const cd_plan_track_t * pt, cd_sink_t * sink, size_t end);
+static int engine_period (cd_engine_t * engine, const cd_gen_t * gen, const cd_track_t * trk, cd_period_t ** period);
+static void engine_period_put (cd_engine_t * engine, cd_period_t * per);
+static void engine_trim (cd_engine_t * engine);
+static void period_free (cd_period_t * per);
+static int period_match (const cd_track_t * a, const cd_track_t * b);
+static const char *engine_writer (const cd_engine_t * engine);
+static void engine_stat (cd_engine_t * engine, cd_stat_t * stat, size_t bytes, double seconds);
+
+int
+cd_main (const cd_disc_t * disc, int argc, char **argv)
+{
+  int ret = CD_OK;
+  cd_options_t opt;
+  int key;
+  static const struct option long_opts[] = {
+    CD_OPTIONS_LONG,
+    {NULL, 0, NULL, 0}
+  };
+
+  memset (&opt, 0, sizeof (opt));
+  while ((CD_OK == ret) && (-1 != (key = getopt_long (argc, argv, CD_OPTIONS_SHORT, long_opts, NULL))))
+    {
+      ret = cd_option (&opt, key, optarg);
+    }
+
+  // Verifying writes nothing, the base name may be left out
+  if ((CD_OK == ret) && ((optind + 1 == argc) || (opt.verify && (optind == argc))))
+    {
+      cd_engine_t *engine = cd_engine_new (&opt);
+
+      ret = engine ? cd_engine_generate (engine, disc, (optind < argc) ? argv[optind] : opt.verify) : CD_ERR_MEM;
+      cd_engine_free (engine);
+    }
+  else
+    {
+      fprintf (stderr, "Incorrect arg.\nUsage: %s " CD_OPTIONS_USAGE " outbasename\n\n", argv[0]);
+      ret = CD_ERR_ARG;
+    }
+
+  return ret;
+}
+
+/*
+    Apply one getopt_long() result from CD_OPTIONS_SHORT/CD_OPTIONS_LONG.
+    -j 0 uses one thread per online CPU, -q 0 the default depth.
+*/
+int
+cd_option (cd_options_t * opt, int key, const char *arg)
+{
+  int ret = CD_OK;
+  char *end = NULL;
+
+  switch (key)
+    {
+    case 'n':
+      opt->dry_run = 1;
+      break;
+    case 's':
+      opt->sparse = 1;
+      break;
+    case 'o':
+      opt->output = arg;
+      break;
+    case 'T':
+      opt->toc = arg;
+      break;
+    case 'f':
+      if (NULL == cd_format_find (arg))
+	{
+	  fprintf (stderr, "Unknown format \"%s\"\n", arg);
+	  ret = CD_ERR_ARG;
+	}
+      else if (CD_FORMAT_MAX == opt->format_num)
+	{
+	  fprintf (stderr, "At most %u formats\n", CD_FORMAT_MAX);
+	  ret = CD_ERR_ARG;
+	}
+      else
+	{
+	  opt->format[opt->format_num++] = arg;
+	}
+      break;
+    case 'C':
+      opt->cue = arg;
+      break;
+    case 'c':
+      opt->cache = arg;
+      break;
+    case 'i':
+      opt->incremental = 1;
+      break;
+    case 'm':
+      opt->manifest = 1;
+      break;
+    case 'a':
+      opt->accurip = 1;
+      break;
+    case 'V':
+      opt->verify = arg;
+      break;
+    case 'j':
+      errno = 0;
+      opt->threads = strtoul (arg, &end, 10);
+      if ((0 != errno) || (end == arg) || ('\0' != *end) || ('-' == *arg))
+	{
+	  fprintf (stderr, "Bad thread count \"%s\"\n", arg);
+	  ret = CD_ERR_ARG;
+	}
+      else if (0U == opt->threads)
+	{
+	  long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	  opt->threads = (0 < cpus) ? (size_t) cpus : 1U;
+	}
+      break;
+    case 'q':
+      errno = 0;
+      opt->queue_depth = strtoul (arg, &end, 10);
+      if ((0 != errno) || (end == arg) || ('\0' != *end) || ('-' == *arg) || (4096U < opt->queue_depth))
+	{
+	  fprintf (stderr, "Bad queue depth \"%s\"\n", arg);
+	  ret = CD_ERR_ARG;
+	}
+      break;
+    case 'w':
+      if (cd_image_find (arg))
+	{
+	  opt->writer = arg;
+	}
+      else
+	{
+	  fprintf (stderr, "Unknown writer \"%s\"\n", arg);
+	  ret = CD_ERR_ARG;
+	}
+      break;
+    default:
+      ret = CD_ERR_ARG;
+      break;
+    }
+
+  return ret;
+}
+
+trk_index_t
+calculate_index (const size_t offset_s)
+{
+  trk_index_t ret;
+
+  const size_t offset = offset_s / cd_frame_size;
+  const size_t deviation = offset_s % cd_frame_size;
+
+  if (deviation)
+    {
+      fprintf (stderr, "Calculated index deviation %lld\n", (long long int) deviation);
+    }
+
+  const size_t div_m = 4500U;
+  const size_t div_s = 75U;
+
+  ret.m = offset / div_m;
+  ret.s = (offset % div_m) / div_s;
+  ret.f = (offset % div_m % div_s);
+
+  return ret;
+}
+
+char *
+cd_make_name (const char *base_name, const char *ext)
+{
+  char *ret = malloc (strlen (base_name) + strlen (ext) + 1U);
+
+  if (ret)
+    {
+      strcpy (ret, base_name);
+      strcat (ret, ext);
+    }
+
+  return ret;
+}
+
+cd_engine_t *
+cd_engine_new (const cd_options_t * opt)
+{
+  cd_engine_t *ret = calloc (1U, sizeof (cd_engine_t));
+
+  if (ret)
+    {
+      if (opt)
+	{
+	  ret->opt = *opt;
+	}
+      ret->periods_max = periods_max_default;
+      pthread_mutex_init (&ret->lock, NULL);
+      if (ret->opt.cache)
+	{
+	  cd_cache_open (ret->opt.cache);
+	}
+
+      const cd_image_ops_t *ops = cd_image_find (engine_writer (ret));
+      if ((1U < ret->opt.threads) && ops && !ops->positional)
+	{
+	  fprintf (stderr, CD_WARN "writer %s is sequential, rendering tracks in order\n", ops->name);
+	  ret->opt.threads = 1U;
+	}
+      if (1U < ret->opt.threads)
+	{
+	  ret->pool = cd_pool_new (ret->opt.threads);
+	  if (NULL == ret->pool)
+	    {
+	      cd_engine_free (ret);
+	      ret = NULL;
+	    }
+	}
+    }
+  else
+    {
+      fprintf (stderr, "Memory allocation error(engine): %s!\n\n", strerror (errno));
+    }
+
+  return ret;
+}
+
+void
+cd_engine_free (cd_engine_t * engine)
+{
+  if (engine)
+    {
+      cd_pool_free (engine->pool);
+      while (engine->periods)
+	{
+	  cd_period_t *next = engine->periods->next;
+	  period_free (engine->periods);
+	  engine->periods = next;
+	}
+      pthread_mutex_destroy (&engine->lock);
+      free (engine);
+    }
+}
+
+int
+generate_image (const cd_disc_t * disc, const char *base_name)
+{
+  int ret = CD_ERR_MEM;
+  cd_engine_t *engine = cd_engine_new (NULL);
+
+  if (engine)
+    {
+      ret = cd_engine_generate (engine, disc, base_name);
+    }
+  cd_engine_free (engine);
+
+  return ret;
+}
+
+/*
+    Open one image per selected format, all at once so that every block
+    is rendered only once and handed to each of them.  With update the
+    images of the previous build are rewritten in place.  With accurip
+    or verify there is no image, only the checksums or the comparison.
+*/
+static int
+engine_open (cd_engine_t * engine, cd_job_t * job, const char *base_name, size_t data_size, int update)
+{
+  int ret = CD_OK;
+  const cd_options_t *opt = &engine->opt;
+  const size_t format_num = opt->format_num ? opt->format_num : 1U;
+
+  if (opt->verify)
+    {
+      ret = engine_verify (engine, job, data_size);
+    }
+  else if (opt->accurip)
+    {
+      ret = engine_accurip (job, data_size);
+    }
+
+  for (size_t fi = 0U; (CD_OK == ret) && !opt->verify && !opt->accurip && (fi < format_num); fi++)
+    {
+      const cd_format_t *fmt = cd_format_for (opt->format_num ? opt->format[fi] : NULL, data_size);
+      cd_image_t *img = &job->img[fi];
+
+      job->img_name[fi] = ((0U == fi) && opt->output) ? strdup (opt->output) : cd_make_name (base_name, fmt->ext);
+      if (NULL == job->img_name[fi])
+	{
+	  fprintf (stderr, "Error allocating memory\n\n");
+	  ret = CD_ERR_MEM;
+	  break;
+	}
+      if (0U < fi)
+	{
+	  // Only a sparse build lists the holes again, the first image's go with the base name
+	  char *holes_name = cd_make_name (job->img_name[fi], ".holes");
+	  if (holes_name)
+	    {
+	      unlink (holes_name);
+	    }
+	  free (holes_name);
+	}
+
+      if (update)
+	{
+	  ret = cd_image_update (img, job->img_name[fi], fmt->header_size + data_size, opt);
+	}
+      else
+	{
+	  ret = cd_image_open (img, cd_image_find (engine_writer (engine)), job->img_name[fi], fmt->header_size + data_size, opt);
+	}
+      job->img_num++;
+      job->img_fmt[fi] = fmt;
+      img->data_offset = fmt->header_size;
+      img->order = fmt->order;
+      if ((CD_OK == ret) && job->digests)
+	{
+	  ret = engine_hasher (job->plan, img);
+	}
+      if (CD_OK == ret)
+	{
+	  ret = cd_format_header (fmt, img, data_size);
+	}
+    }
+
+  return ret;
+}
+
+/* No image, the samples only feed the AccurateRip checksums, little endian without header */
+static int
+engine_accurip (cd_job_t * job, size_t data_size)
+{
+  cd_image_t *img = &job->img[0];
+  int ret = cd_image_discard (img, data_size);
+
+  job->img_num = 1U;
+  img->order = CD_ORDER_LE;
+  if (CD_OK == ret)
+    {
+      img->accurip = cd_accurip_new (job->plan);
+      ret = img->accurip ? CD_OK : CD_ERR_MEM;
+    }
+
+  return ret;
+}
+
+/* No image, every run is compared with the image to verify, in its format (-f or the extension) */
+static int
+engine_verify (cd_engine_t * engine, cd_job_t * job, size_t data_size)
+{
+  const cd_options_t *opt = &engine->opt;
+  const cd_format_t *fmt = opt->format_num ? cd_format_for (opt->format[0], data_size) : cd_format_of (opt->verify, data_size);
+  cd_image_t *img = &job->img[0];
+  int ret = cd_image_discard (img, fmt->header_size + data_size);
+
+  job->img_num = 1U;
+  job->img_fmt[0] = fmt;
+  img->data_offset = fmt->header_size;
+  img->order = fmt->order;
+  if (CD_OK == ret)
+    {
+      img->verify = cd_verify_open (opt->verify, job->plan, img->size, img->data_offset);
+      ret = img->verify ? CD_OK : CD_ERR_FILE;
+    }
+  if (CD_OK == ret)
+    {
+      ret = cd_format_header (fmt, img, data_size);
+    }
+
+  return ret;
+}
+
+/*
+    Incremental build: the tracks to render, from the previous build
+    recorded at build_name, or NULL to render all of them.
+*/
+static uint8_t *
+engine_changed (cd_engine_t * engine, const cd_plan_t * plan, const char *build_name)
+{
+  uint8_t *ret = calloc (plan->tracks_num ? plan->tracks_num : 1U, sizeof (uint8_t));
+
+  if (NULL == ret)
+    {
+      fprintf (stderr, "Memory allocation error(build): %s!\n\n", strerror (errno));
+    }
+  else if (engine->opt.sparse || (0 == strcmp (engine_writer (engine), "stream")))
+    {
+      fprintf (stderr, CD_WARN "incremental builds need a regular image without holes, rebuilding all\n");
+      free (ret);
+      ret = NULL;
+    }
+  else if (CD_OK != cd_build_changed (build_name, plan, &engine->opt, ret))
+    {
+      free (ret);
+      ret = NULL;
+    }
+
+  return ret;
+}
+
+/* Hash img while it is written, the whole image and each track */
+static int
+engine_hasher (const cd_plan_t * plan, cd_image_t * img)
+{
+  size_t *bounds = malloc ((plan->tracks_num + 1U) * sizeof (size_t));
+
+  if (bounds)
+    {
+      for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+	{
+	  bounds[ti] = img->data_offset + plan->tracks[ti].begin * cd_sample_size;
+	}
+      bounds[plan->tracks_num] = img->data_offset + plan->size * cd_sample_size;
+      img->hasher = cd_hasher_new (img->size, bounds, plan->tracks_num);
+    }
+  else
+    {
+      fprintf (stderr, "Memory allocation error(hash): %s!\n\n", strerror (errno));
+    }
+  free (bounds);
+
+  return img->hasher ? CD_OK : CD_ERR_MEM;
+}
+
+/* List the holes if sparse, close all images and write the manifest if hashed */
+static int
+engine_close (cd_job_t * job, const char *base_name, int ret)
+{
+  const size_t digests_num = job->plan->tracks_num + 1U;
+  cd_manifest_image_t images[CD_FORMAT_MAX];
+
+  for (size_t fi = 0U; fi < job->img_num; fi++)
+    {
+      if ((CD_OK == ret) && job->img[fi].sparse)
+	{
+	  char *holes_name = cd_make_name ((0U == fi) ? base_name : job->img_name[fi], ".holes");
+	  ret = holes_name ? cd_image_write_holes (&job->img[fi], holes_name) : CD_ERR_MEM;
+	  free (holes_name);
+	}
+      if ((CD_OK == ret) && job->img[fi].hasher)
+	{
+	  ret = cd_hasher_finish (job->img[fi].hasher, &job->digests[fi * digests_num], &job->digests[fi * digests_num + 1U]);
+	}
+
+      int close_ret = cd_image_close (&job->img[fi]);
+      if (CD_OK == ret)
+	{
+	  ret = close_ret;
+	}
+      images[fi].name = job->img_name[fi];
+      images[fi].format = job->img_fmt[fi] ? job->img_fmt[fi]->name : NULL;
+      images[fi].size = job->img[fi].size;
+      images[fi].data_offset = job->img[fi].data_offset;
+      images[fi].digests = job->digests ? &job->digests[fi * digests_num] : NULL;
+    }
+
+  if ((CD_OK == ret) && job->digests)
+    {
+      ret = cd_manifest_store (job->manifest_name, job->plan, images, job->img_num);
+    }
+  if ((CD_OK == ret) && (0U < job->img_num) && job->img[0].accurip)
+    {
+      ret = cd_accurip_store (job->img[0].accurip, job->accurip_name, job->plan);
+    }
+  if ((CD_OK == ret) && (0U < job->img_num) && job->img[0].verify)
+    {
+      ret = cd_verify_report (job->img[0].verify, stdout);
+    }
+
+  for (size_t fi = 0U; fi < job->img_num; fi++)
+    {
+      cd_hasher_free (job->img[fi].hasher);
+      job->img[fi].hasher = NULL;
+      cd_accurip_free (job->img[fi].accurip);
+      job->img[fi].accurip = NULL;
+      cd_verify_free (job->img[fi].verify);
+      job->img[fi].verify = NULL;
+      free (job->img_name[fi]);
+      job->img_name[fi] = NULL;
+    }
+  job->img_num = 0U;
+
+  return ret;
+}
+
+int
+cd_engine_generate (cd_engine_t * engine, const cd_disc_t * disc, const char *base_name)
+{
+  if (engine->opt.dry_run)
+    {
+      return cd_dry_run (disc, base_name, &engine->opt);
+    }
+
+  cd_plan_t plan;
+  int ret = cd_plan (disc, &plan);
+  const int render_only = engine->opt.accurip || engine->opt.verify;	// Nothing but the checksums or the report
+  cd_job_t job;
+  char *build_name = NULL;
+  char *holes_name = NULL;
+  uint8_t *changed = NULL;	// Tracks to render, NULL for all
+
+  memset (&job, 0, sizeof (job));
+  job.engine = engine;
+  job.plan = &plan;
+
+  if (CD_OK == ret)
+    {
+      size_t pieces_max = 0U;
+      for (size_t ti = 0U; ti < plan.tracks_num; ti++)
+	{
+	  pieces_max += engine_pieces (engine, &plan.tracks[ti]);
+	}
+      job.pieces = calloc (pieces_max ? pieces_max : 1U, sizeof (cd_piece_t));
+      if (NULL == job.pieces)
+	{
+	  fprintf (stderr, "Memory allocation error(job): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  if ((CD_OK == ret) && engine->opt.manifest && !render_only)
+    {
+      job.digests = calloc (CD_FORMAT_MAX * (plan.tracks_num + 1U), sizeof (cd_digest_t));
+      if (NULL == job.digests)
+	{
+	  fprintf (stderr, "Memory allocation error(hash): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      build_name = cd_make_name (base_name, ".build");
+      job.manifest_name = cd_make_name (base_name, ".manifest");
+      job.accurip_name = cd_make_name (base_name, ".accurip");
+      holes_name = cd_make_name (base_name, ".holes");
+      ret = (build_name && job.manifest_name && job.accurip_name && holes_name) ? CD_OK : CD_ERR_MEM;
+    }
+  if ((CD_OK == ret) && !render_only)
+    {
+      // Any build drops the records first, images it leaves behind must not look like the recorded ones
+      changed = engine->opt.incremental ? engine_changed (engine, &plan, build_name) : NULL;
+      unlink (build_name);
+      unlink (job.manifest_name);
+      unlink (holes_name);
+    }
+
+  // The images and their records stay as they are
+  if ((CD_OK == ret) && !render_only)
+    {
+      ret = cd_plan_write (&plan, base_name, &engine->opt);
+    }
+
+  if (CD_OK == ret)
+    {
+      const double t0 = cd_clock ();
+      size_t jobs_num = 0U;
+
+      ret = engine_open (engine, &job, base_name, plan.size * cd_sample_size, NULL != changed);
+      if ((CD_OK != ret) && changed)
+	{
+	  fprintf (stderr, CD_WARN "previous images unusable, rebuilding all\n");
+	  engine_close (&job, base_name, ret);
+	  free (changed);
+	  changed = NULL;
+	  ret = engine_open (engine, &job, base_name, plan.size * cd_sample_size, 0);
+	}
+
+      /*
+         Threaded, hand out the longest pieces first so that the short ones
+         fill the gaps at the end.  When hashing they go in image order,
+         which keeps the bytes queued for the hashers few.  Unchanged
+         tracks are only read back, and only for the hashes.
+       */
+      for (size_t ti = 0U; ti < plan.tracks_num; ti++)
+	{
+	  const cd_plan_track_t *pt = &plan.tracks[ti];
+	  const size_t pieces_num = engine_pieces (engine, pt);
+	  const int keep = changed && !changed[ti];
+
+	  for (size_t pi = 0U; (!keep || job.digests) && (pi < pieces_num); pi++)
+	    {
+	      const cd_piece_t piece = { ti, pi ? (pt->start + pi * piece_len) : pt->begin,
+		(pi + 1U < pieces_num) ? (pt->start + (pi + 1U) * piece_len) : pt->end, keep
+	      };
+	      size_t oi = jobs_num++;
+
+	      while (engine->pool && !job.digests && (0U < oi) && ((job.pieces[oi - 1U].end - job.pieces[oi - 1U].begin) < (piece.end - piece.begin)))
+		{
+		  job.pieces[oi] = job.pieces[oi - 1U];
+		  oi--;
+		}
+	      job.pieces[oi] = piece;
+	    }
+	}
+      if (changed)
+	{
+	  size_t changed_num = 0U;
+	  for (size_t ti = 0U; ti < plan.tracks_num; ti++)
+	    {
+	      changed_num += changed[ti];
+	    }
+	  fprintf (stderr, "Incremental: %lu of %lu tracks changed\n", (unsigned long) changed_num, (unsigned long) plan.tracks_num);
+	}
+
+      if ((CD_OK == ret) && engine->pool)
+	{
+	  ret = cd_pool_run (engine->pool, engine_job, &job, jobs_num);
+	}
+      for (size_t ji = 0U; (CD_OK == ret) && (NULL == engine->pool) && (ji < jobs_num); ji++)
+	{
+	  ret = engine_job (&job, ji);
+	}
+
+      ret = engine_close (&job, base_name, ret);
+      engine_stat (engine, &engine->images, plan.size * cd_sample_size, cd_clock () - t0);
+    }
+
+  if ((CD_OK == ret) && engine->opt.incremental && !render_only)
+    {
+      ret = cd_build_store (build_name, &plan, &engine->opt);
+    }
+
+  fprintf (stderr, "\nDone.\n\n");
+
+  free (changed);
+  free (build_name);
+  free (holes_name);
+  free (job.manifest_name);
+  free (job.accurip_name);
+  free (job.digests);
+  free (job.pieces);
+  cd_plan_free (&plan);
+
+  return ret;
+}
+
+/*
+    Jobs for one track: one, or one per block of a random access track
+    when threaded.  Verifying, periodic tracks are split too, comparing
+    costs more than rendering.
+*/
+static size_t
+engine_pieces (const cd_engine_t * engine, const cd_plan_track_t * pt)
+{
+  size_t ret = 1U;
+  const cd_gen_t *gen = cd_gen_get (pt->trk->type);
+
+  if (engine->pool && (gen->render_at || (engine->opt.verify && !gen->stream)) && (piece_len < pt->end - pt->start))
+    {
+      ret = (pt->end - pt->start + piece_len - 1U) / piece_len;
+    }
+
+  return ret;
+}
+
+/* Render one piece into its own region of the image */
+static int
+engine_job (void *arg, size_t i)
+{
+  cd_job_t *job = arg;
+  const cd_piece_t *piece = &job->pieces[i];
+  const cd_plan_track_t *pt = &job->plan->tracks[piece->ti];
+  cd_sink_t sink;
+  const double t0 = cd_clock ();
+  int ret = piece->keep ? engine_reread (job, piece) : cd_sink_open (&sink, job->img, job->img_num, piece->begin);
+
+  if (!piece->keep)
+    {
+      if (CD_OK == ret)
+	{
+	  ret = write_track (job->engine, pt, (int) piece->ti + 1, &sink, piece->end);
+	}
+
+      int close_ret = cd_sink_close (&sink);
+      if (CD_OK == ret)
+	{
+	  ret = close_ret;
+	}
+      engine_stat (job->engine, &job->engine->stats[pt->trk->type], (piece->end - piece->begin) * cd_sample_size, cd_clock () - t0);
+    }
+
+  // The hashers would wait for this piece forever
+  for (size_t fi = 0U; (CD_OK != ret) && (fi < job->img_num); fi++)
+    {
+      if (job->img[fi].hasher)
+	{
+	  cd_hasher_fail (job->img[fi].hasher);
+	}
+    }
+
+  return ret;
+}
+
+/* Feed the hashers a piece an incremental build left as it was, from the images */
+static int
+engine_reread (cd_job_t * job, const cd_piece_t * piece)
+{
+  int ret = CD_OK;
+  uint8_t *buf = malloc (CD_SINK_BLOCK);
+
+  if (NULL == buf)
+    {
+      fprintf (stderr, "Memory allocation error(hash): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  for (size_t fi = 0U; (CD_OK == ret) && (fi < job->img_num); fi++)
+    {
+      cd_image_t *img = &job->img[fi];
+      const size_t end = img->data_offset + piece->end * cd_sample_size;
+
+      for (size_t offset = img->data_offset + piece->begin * cd_sample_size; (CD_OK == ret) && (offset < end); offset += CD_SINK_BLOCK)
+	{
+	  const size_t len = (CD_SINK_BLOCK < end - offset) ? CD_SINK_BLOCK : (end - offset);
+
+	  ret = cd_image_read (img, offset, buf, len);
+	  if (CD_OK == ret)
+	    {
+	      ret = cd_hasher_feed (img->hasher, offset, buf, len, 1U);
+	    }
+	}
+    }
+
+  free (buf);
+
+  return ret;
+}
+
+/* Writer in use: as selected, stream for stdout, pwrite if threaded, else stdio */
+static const char *
+engine_writer (const cd_engine_t * engine)
+{
+  const char *ret = "stdio";
+
+  if (engine->opt.writer)
+    {
+      ret = engine->opt.writer;
+    }
+  else if (engine->opt.output && (0 == strcmp (engine->opt.output, "-")))
+    {
+      ret = "stream";
+    }
+  else if (1U < engine->opt.threads)
+    {
+      ret = "pwrite";
+    }
+
+  return ret;
+}
+
+/* Monotonic seconds, for the timing reports */
+double
+cd_clock (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void
+engine_stat (cd_engine_t * engine, cd_stat_t * stat, size_t bytes, double seconds)
+{
+  pthread_mutex_lock (&engine->lock);
+  stat->count++;
+  stat->bytes += bytes;
+  stat->seconds += seconds;
+  pthread_mutex_unlock (&engine->lock);
+}
+
+/*
+    Print the time spent per generator (track render and hand over to the
+    writer, pregap included) and per image (open to close, so including
+    writes still in flight) since the engine was created.
+*/
+void
+cd_engine_report (const cd_engine_t * engine, FILE * out)
+{
+  const char *writer = engine_writer (engine);
+
+  for (int gi = 0; gi <= CD_GEN_NUM; gi++)
+    {
+      const cd_stat_t *stat = (CD_GEN_NUM == gi) ? &engine->images : &engine->stats[gi];
+      const char *name = (CD_GEN_NUM == gi) ? "image" : cd_gen_get ((cd_gen_type_t) gi)->name;
+
+      if (stat->count)
+	{
+	  const double mb = (double) stat->bytes / (1024.0 * 1024.0);
+	  fprintf (out, "%-8s %-12s %6lu %10.1f MB %8.3f s %8.1f MB/s\n", writer, name, stat->count, mb, stat->seconds, (0.0 < stat->seconds) ? (mb / stat->seconds) : 0.0);
+	}
+    }
+  if (engine->opt.cache)
+    {
+      fprintf (out, "%-8s %-12s %6lu hits %6lu misses\n", writer, "cache", engine->cache_hits, engine->cache_misses);
+    }
+}
+
+/* Check the optimized kernels against their reference implementations */
+int
+cd_self_check (FILE * out)
+{
+  int ret = cd_pack_check (out);
+
+  if (CD_OK == ret)
+    {
+      ret = cd_plan_check (out);
+    }
+  if (CD_OK == ret)
+    {
+      ret = cd_sincos_check (out);
+    }
+  if (CD_OK == ret)
+    {
+      ret = cd_rng_check (out);
+    }
+  if (CD_OK == ret)
+    {
+      ret = cd_hash_check (out);
+    }
+  if (CD_OK == ret)
+    {
+      ret = cd_accurip_check (out);
+    }
+  if (CD_OK == ret)
+    {
+      ret = cd_verify_check (out);
+    }
+
+  return ret;
+}
+
+/* Check the fast render of every distinct periodic track of disc against libm */
+int
+cd_check_disc (const cd_disc_t * disc, FILE * out)
+{
+  int ret = CD_OK;
+
+  for (size_t ti = 0U; ti < disc->tracks_num; ti++)
+    {
+      const cd_track_t *trk = &disc->tracks[ti];
+      size_t pi = 0U;
+
+      while ((pi < ti) && !period_match (&disc->tracks[pi], trk))
+	{
+	  pi++;
+	}
+      if (pi == ti)
+	{
+	  int check_ret = cd_gen_check (trk, out);
+	  if (CD_OK == ret)
+	    {
+	      ret = check_ret;
+	    }
+	}
+    }
+
+  return ret;
+}
+
+static int
+period_match (const cd_track_t * a, const cd_track_t * b)
+{
+  return (a->type == b->type) && (a->period == b->period) && (a->carrier == b->carrier) && (a->steps == b->steps) && (a->ratio == b->ratio);
+}
+
+/*
+    Return the rendered period for trk, from the engine cache when an
+    earlier track (of this or an earlier disc) used the same parameters,
+    else mapped from the on-disk cache or rendered and stored there.
+    The period is rendered outside the lock, so two threads may render
+    the same one, the second keeps the first copy.  The period is
+    returned in *period, release it with engine_period_put().
+*/
+static int
+engine_period (cd_engine_t * engine, const cd_gen_t * gen, const cd_track_t * trk, cd_period_t ** period)
+{
+  int ret = CD_OK;
+  cd_period_t **prev = &engine->periods;
+  cd_period_t *per = NULL;
+  cd_period_t *found = NULL;
+
+  pthread_mutex_lock (&engine->lock);
+  for (per = engine->periods; per && !period_match (&per->key, trk); per = per->next)
+    {
+      prev = &per->next;
+    }
+  if (per)
+    {
+      *prev = per->next;
+      per->next = engine->periods;
+      engine->periods = per;
+      per->refs++;
+      found = per;
+    }
+  pthread_mutex_unlock (&engine->lock);
+
+  if (NULL == found)
+    {
+      const size_t len = gen->period (trk);
+
+      per = calloc (1U, sizeof (cd_period_t));
+      if (per && (0U < len))
+	{
+	  per->key = *trk;
+	  per->key.index = NULL;
+	  per->key.title = NULL;
+	  per->key.message = NULL;
+	  per->len = len;
+	  per->refs = 1U;
+	  if (engine->opt.cache && (CD_OK == cd_cache_load (engine->opt.cache, trk, len, &per->sam, &per->map, &per->map_len)))
+	    {
+	      pthread_mutex_lock (&engine->lock);
+	      engine->cache_hits++;
+	      pthread_mutex_unlock (&engine->lock);
+	    }
+	  else
+	    {
+	      per->sam = calloc (len, sizeof (sample_t));
+	    }
+	}
+      if (0U == len)
+	{
+	  fprintf (stderr, "Render error (%s): empty period!\n\n", gen->name);
+	  ret = CD_ERR_ARG;
+	}
+      else if ((NULL == per) || (NULL == per->sam))
+	{
+	  fprintf (stderr, "Memory allocation error(data): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_MEM;
+	}
+      else if (!per->map && (CD_OK != (ret = gen->render (trk, per->sam, len))))
+	{
+	  fprintf (stderr, "Render error (%s): %lu samples failed (%d)!\n\n", gen->name, len, ret);
+	}
+      else if (engine->opt.cache && !per->map)
+	{
+	  cd_cache_store (engine->opt.cache, trk, per->sam, len);
+	  pthread_mutex_lock (&engine->lock);
+	  engine->cache_misses++;
+	  pthread_mutex_unlock (&engine->lock);
+	}
+
+      if (CD_OK != ret)
+	{
+	  period_free (per);
+	  per = NULL;
+	}
+    }
+
+  if (per && (NULL == found))
+    {
+      pthread_mutex_lock (&engine->lock);
+      for (found = engine->periods; found && !period_match (&found->key, trk); found = found->next)
+	{
+	}
+      if (found)
+	{
+	  found->refs++;
+	}
+      else
+	{
+	  per->next = engine->periods;
+	  engine->periods = per;
+	  found = per;
+	  per = NULL;
+	}
+      engine_trim (engine);
+      pthread_mutex_unlock (&engine->lock);
+
+      period_free (per);
+    }
+
+  *period = found;
+
+  return ret;
+}
+
+static void
+engine_period_put (cd_engine_t * engine, cd_period_t * per)
+{
+  pthread_mutex_lock (&engine->lock);
+  per->refs--;
+  engine_trim (engine);
+  pthread_mutex_unlock (&engine->lock);
+}
+
+/* Drop least recently used periods beyond periods_max, never one in use.  Called locked. */
+static void
+engine_trim (cd_engine_t * engine)
+{
+  cd_period_t **tail = &engine->periods;
+  size_t kept = 0U;
+
+  while (*tail)
+    {
+      kept += (*tail)->len * sizeof (sample_t);
+      if ((kept > engine->periods_max) && (0U == (*tail)->refs) && (*tail != engine->periods))
+	{
+	  cd_period_t *drop = *tail;
+	  *tail = drop->next;
+	  kept -= drop->len * sizeof (sample_t);
+	  period_free (drop);
+	}
+      else
+	{
+	  tail = &(*tail)->next;
+	}
+    }
+}
+
+static void
+period_free (cd_period_t * per)
+{
+  if (per)
+    {
+      if (per->map)
+	{
+	  munmap (per->map, per->map_len);
+	}
+      else
+	{
+	  free (per->sam);
+	}
+      free (per);
+    }
+}
+
+/* Random access body from the sink position up to end, a sink block at a time */
+static int
+write_track_at (const cd_gen_t * gen, const cd_plan_track_t * pt, cd_sink_t * sink, size_t end)
+{
+  int ret = CD_OK;
+  const size_t buf_len = CD_SINK_BLOCK / cd_sample_size;
+  sample_t *sam = malloc (buf_len * sizeof (sample_t));
+
+  if (NULL == sam)
+    {
+      fprintf (stderr, "Memory allocation error(data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  while ((CD_OK == ret) && (end > sink->pos))
+    {
+      const size_t len = (end - sink->pos < buf_len) ? (end - sink->pos) : buf_len;
+
+      ret = gen->render_at (pt->trk, sink->pos - pt->start, sam, len);
+      if (CD_OK == ret)
+	{
+	  ret = cd_sink_write (sink, sam, len);
+	}
+    }
+
+  free (sam);
+
+  return ret;
+}
+
+/* Track body from the sink position up to end, streamed tracks are never split */
+static int
+write_track_data (cd_engine_t * engine, const cd_gen_t * gen, const cd_plan_track_t * pt, const int trk_i, cd_sink_t * sink, size_t end)
+{
+  int ret = CD_OK;
+
+  if (gen->render_at)
+    {
+      fprintf (stderr, "Track %02d: %s samples %lu to %lu\n", trk_i, gen->name, sink->pos - pt->start, end - pt->start);
+      ret = write_track_at (gen, pt, sink, end);
+    }
+  else if (gen->stream)
+    {
+      fprintf (stderr, "Track %02d: %s stream\n", trk_i, gen->name);
+      ret = gen->stream (pt->trk, sink);
+    }
+  else
+    {
+      cd_period_t *per = NULL;
+
+      ret = engine_period (engine, gen, pt->trk, &per);
+      if (CD_OK == ret)
+	{
+	  // A piece may start and end inside a period
+	  const size_t phase = (sink->pos - pt->start) % per->len;
+	  const size_t head = phase ? (((per->len - phase) < (end - sink->pos)) ? (per->len - phase) : (end - sink->pos)) : 0U;
+
+	  fprintf (stderr, "Track %02d: %s buf_len:%lu bufsize:%lu\n", trk_i, gen->name, per->len, per->len * cd_sample_size);
+	  if (0U < head)
+	    {
+	      ret = cd_sink_write (sink, per->sam + phase, head);
+	    }
+	  if ((CD_OK == ret) && (per->len <= end - sink->pos))
+	    {
+	      ret = cd_sink_repeat (sink, per->sam, per->len, (end - sink->pos) / per->len);
+	    }
+	  if ((CD_OK == ret) && (end > sink->pos))
+	    {
+	      ret = cd_sink_write (sink, per->sam, end - sink->pos);
+	    }
+	  engine_period_put (engine, per);
+	}
+    }
+
+  return ret;
+}
+
+/* Track from the sink position up to end, the whole track unless it is random access */
+static int
+write_track (cd_engine_t * engine, const cd_plan_track_t * pt, const int trk_i, cd_sink_t * sink, size_t end)
+{
+  int ret = CD_OK;
+  const cd_gen_t *gen = cd_gen_get (pt->trk->type);
+
+  if (pt->begin == sink->pos)
+    {
+      fprintf (stderr, "===\nwrite_track: trk_i=%d, pregap=%lu, *pos=%lu\n", trk_i, pt->start - pt->begin, sink->pos);
+    }
+
+  // Write a pregap if any
+  if (pt->start > sink->pos)
+    {
+      ret = cd_sink_zero (sink, pt->start - sink->pos);
+    }
+
+  // Write wave data
+  if (CD_OK == ret)
+    {
+      ret = write_track_data (engine, gen, pt, trk_i, sink, end);
+    }
+
+  if ((CD_OK == ret) && (end != sink->pos))
+    {
+      fprintf (stderr, "Track %02d: rendered up to %lu, planned %lu\n", trk_i, sink->pos, end);
+      ret = CD_ERR_ARG;
+    }
+
+  return ret;
+}
@@ -0,0 +1,250 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    libcdgen - test CD image generation engine
+
+    A disc is described by a cd_disc_t holding the CD-TEXT header and an
+    array of cd_track_t.  Every track names one of the waveform generators
+    below together with its geometry; cd_generate_image() renders the
+    audio into <base>.cdr and writes the matching <base>.toc and <base>.cue.
+*/
+
+#ifndef CDGEN_H
+#define CDGEN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define CD_OK (0)
+#define CD_ERR_ARG (-1)
+#define CD_ERR_FILE (-2)
+#define CD_ERR_MEM (-3)
+#define CD_ERR_DIFF (-4)		// Verified image differs
+
+#define CD_WARN "WARN: "
+
+static const int cd_sample_size = 4;
+static const int cd_fd = 44100;
+static const size_t cd_frame_size = 588U;
+static const size_t cd_disc_frames_max = 360000U;	// 80 min, Red Book
+
+typedef struct
+{
+  size_t m;
+  size_t s;
+  size_t f;
+} trk_index_t;
+
+typedef struct
+{
+  uint16_t l;
+  uint16_t r;
+} sample_16_t;
+
+/* Byte order of image samples, and of the build host */
+typedef enum
+{
+  CD_ORDER_BE = 0,
+  CD_ORDER_LE = 1
+} cd_order_t;
+
+#if defined(__BYTE_ORDER__) && (__ORDER_BIG_ENDIAN__ == __BYTE_ORDER__)
+#define CD_HOST_BE (1)
+#define CD_HOST_ORDER CD_ORDER_BE
+#else
+#define CD_HOST_BE (0)
+#define CD_HOST_ORDER CD_ORDER_LE
+#endif
+
+/* Bytes of a sample in memory, a,b,c,d is big endian on any host */
+typedef struct
+{
+#if CD_HOST_BE
+  uint8_t a;
+  uint8_t b;
+  uint8_t c;
+  uint8_t d;
+#else
+  uint8_t b;
+  uint8_t a;
+  uint8_t d;
+  uint8_t c;
+#endif
+} sample_raw_t;
+
+typedef union
+{
+  sample_16_t s;
+  sample_raw_t r;
+} sample_t;
+
+typedef enum
+{
+  CD_GEN_TONE = 0,		// Sine, symmetrical half periods
+  CD_GEN_SQUARE,		// Full scale square wave
+  CD_GEN_PULSE,			// Single full scale sample per half period
+  CD_GEN_TRIANGLE,		// Full scale triangle, period is a power of two
+  CD_GEN_AM_SINE,		// Sine carrier, raised cosine envelope
+  CD_GEN_AM_TRIANGLE,		// Sine carrier, triangle envelope
+  CD_GEN_FM_STEP,		// Sine stepping through period / ratio^k
+  CD_GEN_NOISE,			// random() white noise
+  CD_GEN_SILENCE,		// Zero level and clapping silence strips
+  CD_GEN_PHILOX,		// Counter based white noise, seekable
+  CD_GEN_NUM
+} cd_gen_type_t;
+
+typedef struct
+{
+  cd_gen_type_t type;
+  size_t length;		// Frames, pregap excluded
+  size_t pregap;		// Frames
+  size_t period;		// Samples per period (FM step: per step buffer)
+  size_t carrier;		// AM: carrier periods per envelope period
+  size_t steps;			// FM step: number of frequencies
+  size_t ratio;			// FM step: frequency ratio between steps
+  size_t strips;		// Silence: number of strips, INDEX on each
+  unsigned int seed;		// Noise: srandom() seed, philox: key
+  const size_t *index;		// Frames from INDEX 01, for INDEX 02 onwards
+  size_t index_num;		// 0 selects the generator default
+  const char *title;		// NULL selects the generator default
+  const char *message;		// NULL selects the generator default
+} cd_track_t;
+
+typedef struct
+{
+  const char *title;
+  const char *performer;
+  const char *message;
+  const cd_track_t *tracks;
+  size_t tracks_num;
+} cd_disc_t;
+
+#define CD_INDEX_MAX (99U)
+
+/* Bump allocator, see cdgen_arena.c */
+typedef struct
+{
+  struct cd_arena_blk *head;
+} cd_arena_t;
+
+/*
+    Disc model computed before any audio is rendered: layout, indexes
+    and CD-TEXT, everything the TOC, CUE and other descriptions are
+    written from.  Positions and lengths are in samples from the start
+    of the image.  Strings and index lists live in the plan arena.
+*/
+typedef struct
+{
+  const cd_track_t *trk;
+  size_t begin;			// INDEX 00, pregap start
+  size_t start;			// INDEX 01
+  size_t end;			// Next track begin
+  size_t period;		// Samples per rendered period, 0 if streamed
+  const size_t *index;		// INDEX 02 onwards
+  size_t index_num;
+  const char *title;
+  const char *performer;
+  const char *message;
+  const char *rem;		// Extra CUE REM line, NULL for none
+} cd_plan_track_t;
+
+typedef struct
+{
+  const cd_disc_t *disc;
+  const char *title;
+  const char *performer;
+  const char *message;
+  cd_plan_track_t *tracks;
+  size_t tracks_num;
+  size_t size;			// Whole image
+  cd_arena_t arena;
+} cd_plan_t;
+
+/*
+    Engine, shared between the discs generated in one process.  Rendered
+    periods are kept and reused by every later track with the same
+    generator parameters.
+*/
+typedef struct cd_engine cd_engine_t;
+
+#define CD_FORMAT_MAX (4U)
+
+/* Engine options, all zero selects the defaults */
+typedef struct
+{
+  const char *writer;		// Image writer, NULL selects stdio (pwrite if threaded)
+  size_t threads;		// Tracks rendered at once, 0 or 1 renders in order
+  size_t queue_depth;		// uring writer: blocks in flight, 0 selects 8
+  int dry_run;			// Plan and report, write nothing
+  int sparse;			// Leave zero runs as holes, listed in <base>.holes
+  const char *output;		// First image path instead of <base>.cdr, "-" is stdout
+  const char *toc;		// TOC path instead of <base>.toc
+  const char *cue;		// CUE path instead of <base>.cue
+  const char *format[CD_FORMAT_MAX];	// Containers rendered at once: cdr (default), wav, rf64, aiff, bin
+  size_t format_num;
+  const char *cache;		// Directory of rendered periods kept between runs, NULL for none
+  int incremental;		// Render only the tracks changed since <base>.build
+  int manifest;			// Hash the images while writing, into <base>.manifest
+  int accurip;			// Checksums per track into <base>.accurip, no image written
+  const char *verify;		// Image compared with the render instead of writing one, NULL for none
+} cd_options_t;
+
+/* getopt_long() entries for the options above, see cd_option() */
+#define CD_OPTIONS_SHORT "nj:w:q:so:T:C:f:c:imaV:"
+#define CD_OPTIONS_LONG \
+  {"dry-run", no_argument, NULL, 'n'}, \
+  {"jobs", required_argument, NULL, 'j'}, \
+  {"writer", required_argument, NULL, 'w'}, \
+  {"queue-depth", required_argument, NULL, 'q'}, \
+  {"sparse", no_argument, NULL, 's'}, \
+  {"output", required_argument, NULL, 'o'}, \
+  {"toc", required_argument, NULL, 'T'}, \
+  {"cue", required_argument, NULL, 'C'}, \
+  {"format", required_argument, NULL, 'f'}, \
+  {"cache", required_argument, NULL, 'c'}, \
+  {"incremental", no_argument, NULL, 'i'}, \
+  {"manifest", no_argument, NULL, 'm'}, \
+  {"accuraterip", no_argument, NULL, 'a'}, \
+  {"verify", required_argument, NULL, 'V'}
+#define CD_OPTIONS_USAGE "[-n|--dry-run] [-j|--jobs N] [-w|--writer name] [-q|--queue-depth N] [-s|--sparse] [-o|--output image|-] [--toc path] [--cue path] [-f|--format cdr|wav|rf64|aiff|bin ...] [-c|--cache dir] [-i|--incremental] [-m|--manifest] [-a|--accuraterip] [-V|--verify image]"
+
+/* Disc loaded from a text spec file, see specs/README */
+typedef struct cd_spec cd_spec_t;
+
+trk_index_t calculate_index (const size_t offset);
+int generate_image (const cd_disc_t * disc, const char *base_name);
+int cd_main (const cd_disc_t * disc, int argc, char **argv);
+
+int cd_plan (const cd_disc_t * disc, cd_plan_t * plan);
+void cd_plan_free (cd_plan_t * plan);
+int cd_plan_write (const cd_plan_t * plan, const char *base_name, const cd_options_t * opt);
+int cd_dry_run (const cd_disc_t * disc, const char *base_name, const cd_options_t * opt);
+
+int cd_option (cd_options_t * opt, int key, const char *arg);
+cd_engine_t *cd_engine_new (const cd_options_t * opt);
+void cd_engine_free (cd_engine_t * engine);
+int cd_engine_generate (cd_engine_t * engine, const cd_disc_t * disc, const char *base_name);
+void cd_engine_report (const cd_engine_t * engine, FILE * out);
+int cd_self_check (FILE * out);
+int cd_check_disc (const cd_disc_t * disc, FILE * out);
+
+cd_spec_t *cd_spec_load (const char *path);
+void cd_spec_free (cd_spec_t * spec);
+const cd_disc_t *cd_spec_disc (const cd_spec_t * spec);
+const char *cd_spec_output (const cd_spec_t * spec);
+
+#endif /* CDGEN_H */
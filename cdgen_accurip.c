@@ -0,0 +1,636 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    AccurateRip and CUETools checksums of every track, from the runs a
+    sink writes, without an image.  Tracks run from INDEX 01 to the next
+    track's INDEX 01, the last one to the end of the disc; samples are
+    the little endian 32 bit words L | R << 16.
+
+      ARv1  sum of m * w mod 2^32, m the sample position from 1
+      ARv2  sum of the low and high halves of the 64 bit m * w
+      CRC32, CRC32 W/O NULL  of the track bytes, the latter skipping
+            16 bit values of zero (CUETools, CTDB tools)
+
+    The first track leaves out its first 5 frames but the last sample,
+    the last track its last 5 frames.  A run of count copies of a period
+    costs one pass over the period: ARv1 has a closed form per sample
+    of the period, the high halves of ARv2 are a floor sum, and the
+    CRCs of the copies are combined by squaring.  Runs may come in any
+    order from any thread, the CRCs of each track are combined in image
+    order at the end.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "cdgen_int.h"
+
+#define ACCURIP_VERSION (1)
+#define ACCURIP_SKIP (5U * cd_frame_size)	// Samples left out at the disc edges
+#define ACCURIP_CLOSED_MIN (8U)	// Periods from which the closed form is used
+
+/* CRCs of a part of a track */
+typedef struct
+{
+  size_t pos;			// First sample
+  size_t len;			// Samples
+  uint32_t crc;
+  uint32_t nz_crc;
+  uint64_t nz_len;		// Bytes of the non zero 16 bit values
+} accurip_seg_t;
+
+typedef struct
+{
+  size_t start;			// INDEX 01
+  size_t end;			// Next INDEX 01
+  size_t from;			// Positions counted by ARv1/v2, from 1
+  size_t to;
+  uint32_t v1;
+  uint32_t v2;
+  accurip_seg_t *segs;
+  size_t segs_num;
+  size_t segs_cap;
+} accurip_track_t;
+
+struct cd_accurip
+{
+  pthread_mutex_t lock;
+  accurip_track_t *tracks;
+  size_t tracks_num;
+  int failed;
+};
+
+static uint32_t ar_word (const uint8_t * buf, size_t i);
+static uint64_t ar_floor_sum (uint64_t n, uint64_t m, uint64_t a, uint64_t b);
+static void ar_direct (const uint8_t * pat, size_t len, size_t phase, size_t m, size_t n, uint32_t * v1, uint32_t * v2);
+static void ar_run (const uint8_t * pat, size_t len, size_t phase, size_t m, size_t n, uint32_t * v1, uint32_t * v2);
+static uint32_t nz_crc (uint32_t crc, const uint8_t * buf, size_t len, uint64_t * nz_len);
+static void crc_run (const uint8_t * pat, size_t len, size_t phase, size_t n, accurip_seg_t * seg);
+static int seg_cmp (const void *a, const void *b);
+static int accurip_finish (cd_accurip_t * acc, uint32_t * sums);
+
+/* Sample i of a little endian image run as an AccurateRip word */
+static uint32_t
+ar_word (const uint8_t * buf, size_t i)
+{
+  const uint8_t *p = buf + i * cd_sample_size;
+
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* Sum of floor((a * i + b) / m) for i below n, mod 2^64; a * n + b must fit */
+static uint64_t
+ar_floor_sum (uint64_t n, uint64_t m, uint64_t a, uint64_t b)
+{
+  uint64_t ret = 0U;
+
+  while (0U != n)
+    {
+      ret += (n * (n - 1U) / 2U) * (a / m) + n * (b / m);
+      a %= m;
+      b %= m;
+
+      const uint64_t y = a * n + b;
+      if (y < m)
+	{
+	  break;
+	}
+      n = y / m;
+      b = y % m;
+
+      const uint64_t t = m;
+      m = a;
+      a = t;
+    }
+
+  return ret;
+}
+
+/* n samples from phase of a len sample pattern, the first at position m */
+static void
+ar_direct (const uint8_t * pat, size_t len, size_t phase, size_t m, size_t n, uint32_t * v1, uint32_t * v2)
+{
+  uint32_t lo = 0U;
+  uint32_t hi = 0U;
+
+  for (size_t i = 0U; i < n; i++, m++)
+    {
+      const uint64_t x = (uint64_t) m * ar_word (pat, phase);
+
+      lo += (uint32_t) x;
+      hi += (uint32_t) (x >> 32);
+      if (len == ++phase)
+	{
+	  phase = 0U;
+	}
+    }
+
+  *v1 += lo;
+  *v2 += lo + hi;
+}
+
+/*
+    As ar_direct(), whole periods at once.  Sample j of the pattern is
+    at positions b + k * len for k below c, b = m + j: its products sum
+    to w * (c * b + len * c * (c - 1) / 2), the high halves to the floor
+    sum of (w * len * k + w * b) / 2^32.
+*/
+static void
+ar_run (const uint8_t * pat, size_t len, size_t phase, size_t m, size_t n, uint32_t * v1, uint32_t * v2)
+{
+  const size_t head = (0U == phase) ? 0U : ((len - phase < n) ? (len - phase) : n);
+  const size_t c = (n - head) / len;
+
+  ar_direct (pat, len, phase, m, head, v1, v2);
+  m += head;
+  n -= head;
+
+  if (ACCURIP_CLOSED_MIN <= c)
+    {
+      const uint64_t steps = (uint64_t) len * (c * (c - 1U) / 2U);
+      uint32_t lo = 0U;
+      uint32_t hi = 0U;
+
+      for (size_t j = 0U; j < len; j++)
+	{
+	  const uint64_t w = ar_word (pat, j);
+
+	  if (0U != w)
+	    {
+	      const uint64_t b = m + j;
+
+	      lo += (uint32_t) (w * ((uint64_t) c * b + steps));
+	      hi += (uint32_t) ar_floor_sum (c, (uint64_t) 1U << 32, w * len, w * b);
+	    }
+	}
+      *v1 += lo;
+      *v2 += lo + hi;
+      m += c * len;
+      n -= c * len;
+    }
+
+  ar_direct (pat, len, 0U, m, n, v1, v2);
+}
+
+/* CRC32 continued over the non zero 16 bit values of buf */
+static uint32_t
+nz_crc (uint32_t crc, const uint8_t * buf, size_t len, uint64_t * nz_len)
+{
+  uint8_t tmp[4096];
+  size_t tmp_len = 0U;
+
+  for (size_t i = 0U; i < len; i += 2U)
+    {
+      if ((0U != buf[i]) || (0U != buf[i + 1U]))
+	{
+	  tmp[tmp_len++] = buf[i];
+	  tmp[tmp_len++] = buf[i + 1U];
+	}
+      if ((sizeof (tmp) == tmp_len) || ((i + 2U >= len) && (0U < tmp_len)))
+	{
+	  crc = cd_crc32 (crc, tmp, tmp_len);
+	  *nz_len += tmp_len;
+	  tmp_len = 0U;
+	}
+    }
+
+  return crc;
+}
+
+/* CRCs of n samples from phase of a len sample pattern, repeated */
+static void
+crc_run (const uint8_t * pat, size_t len, size_t phase, size_t n, accurip_seg_t * seg)
+{
+  const size_t head = (len - phase < n) ? (len - phase) : n;
+  const size_t c = (n - head) / len;
+  const size_t tail = n - head - c * len;
+
+  seg->len = n;
+  seg->nz_len = 0U;
+  seg->crc = cd_crc32 (0U, pat + phase * cd_sample_size, head * cd_sample_size);
+  seg->nz_crc = nz_crc (0U, pat + phase * cd_sample_size, head * cd_sample_size, &seg->nz_len);
+
+  if (0U < c)
+    {
+      uint64_t nz_len = 0U;
+      const uint32_t crc = cd_crc32 (0U, pat, len * cd_sample_size);
+      const uint32_t nz = nz_crc (0U, pat, len * cd_sample_size, &nz_len);
+
+      seg->crc = cd_crc32_combine (seg->crc, cd_crc32_repeat (crc, len * cd_sample_size, c), (uint64_t) c * len * cd_sample_size);
+      seg->nz_crc = cd_crc32_combine (seg->nz_crc, cd_crc32_repeat (nz, nz_len, c), c * nz_len);
+      seg->nz_len += c * nz_len;
+    }
+
+  seg->crc = cd_crc32 (seg->crc, pat, tail * cd_sample_size);
+  seg->nz_crc = nz_crc (seg->nz_crc, pat, tail * cd_sample_size, &seg->nz_len);
+}
+
+cd_accurip_t *
+cd_accurip_new (const cd_plan_t * plan)
+{
+  cd_accurip_t *ret = calloc (1U, sizeof (cd_accurip_t));
+
+  if (ret)
+    {
+      ret->tracks = calloc (plan->tracks_num ? plan->tracks_num : 1U, sizeof (accurip_track_t));
+      if (NULL == ret->tracks)
+	{
+	  free (ret);
+	  ret = NULL;
+	}
+    }
+
+  if (ret)
+    {
+      pthread_mutex_init (&ret->lock, NULL);
+      ret->tracks_num = plan->tracks_num;
+      for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+	{
+	  accurip_track_t *at = &ret->tracks[ti];
+
+	  at->start = plan->tracks[ti].start;
+	  at->end = (ti + 1U < plan->tracks_num) ? plan->tracks[ti + 1U].start : plan->size;
+	  at->from = (0U == ti) ? ACCURIP_SKIP : 1U;
+	  at->to = at->end - at->start;
+	  if (ti + 1U == plan->tracks_num)
+	    {
+	      at->to = (ACCURIP_SKIP < at->to) ? (at->to - ACCURIP_SKIP) : 0U;
+	    }
+	}
+    }
+  else
+    {
+      fprintf (stderr, "Memory allocation error(accurip): %s!\n\n", strerror (errno));
+    }
+
+  return ret;
+}
+
+/*
+    count copies of len bytes at image offset, the little endian samples
+    of a data_offset 0 image, buf NULL for zeros.
+*/
+int
+cd_accurip_feed (cd_accurip_t * acc, size_t offset, const uint8_t * buf, size_t len, size_t count)
+{
+  int ret = ((0U == offset % cd_sample_size) && (0U == len % cd_sample_size) && (0U < len)) ? CD_OK : CD_ERR_ARG;
+  const size_t pos = offset / cd_sample_size;
+  const size_t pat_len = len / cd_sample_size;
+  const size_t end = pos + pat_len * count;
+
+  for (size_t ti = 0U; (CD_OK == ret) && (ti < acc->tracks_num); ti++)
+    {
+      accurip_track_t *at = &acc->tracks[ti];
+      const size_t a = (pos < at->start) ? at->start : pos;
+      const size_t b = (end < at->end) ? end : at->end;
+
+      if (a >= b)
+	{
+	  continue;
+	}
+
+      // Counted positions of the run inside the track
+      const size_t ma = (a - at->start + 1U < at->from) ? at->from : (a - at->start + 1U);
+      const size_t mb = (b - at->start < at->to) ? (b - at->start) : at->to;
+      accurip_seg_t seg = { a, b - a, 0U, 0U, 0U };
+      uint32_t v1 = 0U;
+      uint32_t v2 = 0U;
+
+      if (buf)
+	{
+	  if (ma <= mb)
+	    {
+	      ar_run (buf, pat_len, (at->start + ma - 1U - pos) % pat_len, ma, mb - ma + 1U, &v1, &v2);
+	    }
+	  crc_run (buf, pat_len, (a - pos) % pat_len, b - a, &seg);
+	}
+      else
+	{
+	  seg.crc = cd_crc32_zeros ((uint64_t) (b - a) * cd_sample_size);
+	}
+
+      pthread_mutex_lock (&acc->lock);
+      if (at->segs_num == at->segs_cap)
+	{
+	  const size_t cap = at->segs_cap ? (2U * at->segs_cap) : 16U;
+	  accurip_seg_t *segs = realloc (at->segs, cap * sizeof (accurip_seg_t));
+
+	  if (segs)
+	    {
+	      at->segs = segs;
+	      at->segs_cap = cap;
+	    }
+	  else
+	    {
+	      fprintf (stderr, "Memory allocation error(accurip): %s!\n\n", strerror (errno));
+	      ret = CD_ERR_MEM;
+	      acc->failed = 1;
+	    }
+	}
+      if (CD_OK == ret)
+	{
+	  at->segs[at->segs_num++] = seg;
+	  at->v1 += v1;
+	  at->v2 += v2;
+	}
+      pthread_mutex_unlock (&acc->lock);
+    }
+
+  return ret;
+}
+
+static int
+seg_cmp (const void *a, const void *b)
+{
+  const accurip_seg_t *sa = a;
+  const accurip_seg_t *sb = b;
+
+  return (sa->pos > sb->pos) - (sa->pos < sb->pos);
+}
+
+/* ARv1, ARv2, CRC32 and CRC32 W/O NULL of every track into sums, 4 per track */
+static int
+accurip_finish (cd_accurip_t * acc, uint32_t * sums)
+{
+  int ret = acc->failed ? CD_ERR_MEM : CD_OK;
+
+  for (size_t ti = 0U; (CD_OK == ret) && (ti < acc->tracks_num); ti++)
+    {
+      accurip_track_t *at = &acc->tracks[ti];
+      size_t pos = at->start;
+      uint32_t crc = 0U;
+      uint32_t nz = 0U;
+
+      qsort (at->segs, at->segs_num, sizeof (accurip_seg_t), seg_cmp);
+      for (size_t si = 0U; (CD_OK == ret) && (si < at->segs_num); si++)
+	{
+	  const accurip_seg_t *seg = &at->segs[si];
+
+	  if (pos != seg->pos)
+	    {
+	      ret = CD_ERR_ARG;
+	    }
+	  crc = cd_crc32_combine (crc, seg->crc, (uint64_t) seg->len * cd_sample_size);
+	  nz = cd_crc32_combine (nz, seg->nz_crc, seg->nz_len);
+	  pos += seg->len;
+	}
+      if ((CD_OK != ret) || (pos != at->end))
+	{
+	  fprintf (stderr, "accurip: track %lu not covered at sample %lu!\n\n", (unsigned long) ti + 1UL, (unsigned long) pos);
+	  ret = CD_ERR_ARG;
+	}
+
+      sums[ti * 4U] = at->v1;
+      sums[ti * 4U + 1U] = at->v2;
+      sums[ti * 4U + 2U] = crc;
+      sums[ti * 4U + 3U] = nz;
+    }
+
+  return ret;
+}
+
+/*
+    Write the disc IDs the AccurateRip database is keyed by and the
+    checksums of every track to path.  Track offsets are the INDEX 01
+    frames, the lead-out the image end.
+*/
+int
+cd_accurip_store (cd_accurip_t * acc, const char *path, const cd_plan_t * plan)
+{
+  int ret = CD_OK;
+  uint32_t *sums = calloc (plan->tracks_num * 4U + 1U, sizeof (uint32_t));
+  char *tmp = cd_make_name (path, ".tmp");
+  FILE *out = NULL;
+  const uint32_t leadout = (uint32_t) (plan->size / cd_frame_size);
+  uint32_t id1 = leadout;
+  uint32_t id2 = leadout * (uint32_t) (plan->tracks_num + 1U);
+  uint32_t cddb = 0U;
+
+  if ((NULL == sums) || (NULL == tmp))
+    {
+      fprintf (stderr, "Memory allocation error(accurip): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+  if (CD_OK == ret)
+    {
+      ret = accurip_finish (acc, sums);
+    }
+  if (CD_OK == ret)
+    {
+      out = fopen (tmp, "wt");
+      if (NULL == out)
+	{
+	  fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+	{
+	  const uint32_t lba = (uint32_t) (plan->tracks[ti].start / cd_frame_size);
+
+	  id1 += lba;
+	  id2 += ((0U < lba) ? lba : 1U) * (uint32_t) (ti + 1U);
+	  for (uint32_t secs = (lba + 150U) / 75U; 0U < secs; secs /= 10U)
+	    {
+	      cddb += secs % 10U;
+	    }
+	}
+      if (0U < plan->tracks_num)
+	{
+	  cddb = ((cddb % 255U) << 24) | ((((leadout + 150U) / 75U) - ((uint32_t) (plan->tracks[0].start / cd_frame_size) + 150U) / 75U) << 8)
+	    | (uint32_t) plan->tracks_num;
+	}
+
+      fprintf (out, "cdgen accuraterip v%d render v%d\n", ACCURIP_VERSION, CD_RENDER_VERSION);
+      fprintf (out, "disc tracks=%lu id1=%08x id2=%08x cddb=%08x\n", (unsigned long) plan->tracks_num, id1, id2, cddb);
+      fprintf (out, "url http://www.accuraterip.com/accuraterip/%x/%x/%x/dBAR-%03lu-%08x-%08x-%08x.bin\n", id1 & 0xfU, (id1 >> 4) & 0xfU,
+	       (id1 >> 8) & 0xfU, (unsigned long) plan->tracks_num, id1, id2, cddb);
+      for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+	{
+	  const accurip_track_t *at = &acc->tracks[ti];
+
+	  fprintf (out, "track %lu lba=%lu samples=%lu arv1=%08x arv2=%08x crc32=%08x crc32_wonull=%08x\n", (unsigned long) ti + 1UL,
+		   (unsigned long) (at->start / cd_frame_size), (unsigned long) (at->end - at->start), sums[ti * 4U], sums[ti * 4U + 1U],
+		   sums[ti * 4U + 2U], sums[ti * 4U + 3U]);
+	}
+
+      if ((0 != fclose (out)) || (0 != rename (tmp, path)))
+	{
+	  fprintf (stderr, "Write error (accurip): %s!\n\n", strerror (errno));
+	  unlink (tmp);
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  free (tmp);
+  free (sums);
+
+  return ret;
+}
+
+void
+cd_accurip_free (cd_accurip_t * acc)
+{
+  if (acc)
+    {
+      for (size_t ti = 0U; ti < acc->tracks_num; ti++)
+	{
+	  free (acc->tracks[ti].segs);
+	}
+      pthread_mutex_destroy (&acc->lock);
+      free (acc->tracks);
+      free (acc);
+    }
+}
+
+/*
+    Feed a three track disc as periodic runs, out of order, and as a
+    rendered buffer in odd blocks, and compare both with the checksums
+    computed sample by sample from their definitions.
+*/
+int
+cd_accurip_check (FILE * out)
+{
+  int ret = CD_OK;
+  const size_t pat_len = 1000U + 3U;
+  const size_t count = 4001U;
+  const size_t size = 3U * cd_frame_size + pat_len * count + 7U * cd_frame_size;
+  cd_plan_track_t tracks[3];
+  cd_plan_t plan;
+  uint8_t *pat = malloc (pat_len * cd_sample_size);
+  uint8_t *img = calloc (size, cd_sample_size);
+  uint32_t ref[3 * 4];
+  uint32_t sums[2][3 * 4];
+  double t[2] = { 0.0, 0.0 };
+
+  memset (tracks, 0, sizeof (tracks));
+  memset (&plan, 0, sizeof (plan));
+  memset (sums, 0, sizeof (sums));
+  tracks[0].start = 3U * cd_frame_size;
+  tracks[1].start = tracks[0].start + 3U * pat_len + 5U;
+  tracks[2].start = tracks[0].start + pat_len * count - 2U * cd_frame_size;
+  plan.tracks = tracks;
+  plan.tracks_num = 3U;
+  plan.size = size;
+
+  if ((NULL == pat) || (NULL == img))
+    {
+      fprintf (stderr, "Memory allocation error(accurip): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  for (size_t i = 0U; (CD_OK == ret) && (i < pat_len * cd_sample_size); i++)
+    {
+      // Zero 16 bit values as well, for W/O NULL
+      pat[i] = (0U == (i / 2U) % 7U) ? 0U : (uint8_t) (i * 2654435761U >> 13);
+    }
+  for (size_t i = 0U; (CD_OK == ret) && (i < count); i++)
+    {
+      memcpy (img + (tracks[0].start + i * pat_len) * cd_sample_size, pat, pat_len * cd_sample_size);
+    }
+
+  // Reference
+  for (size_t ti = 0U; (CD_OK == ret) && (ti < 3U); ti++)
+    {
+      const size_t start = tracks[ti].start;
+      const size_t n = ((ti < 2U) ? tracks[ti + 1U].start : size) - start;
+      uint64_t nz_len = 0U;
+
+      ref[ti * 4U] = 0U;
+      ref[ti * 4U + 1U] = 0U;
+      for (size_t m = 1U; m <= n; m++)
+	{
+	  const uint64_t x = (uint64_t) m * ar_word (img, start + m - 1U);
+
+	  if (((0U < ti) || (ACCURIP_SKIP <= m)) && ((ti < 2U) || (m + ACCURIP_SKIP <= n)))
+	    {
+	      ref[ti * 4U] += (uint32_t) x;
+	      ref[ti * 4U + 1U] += (uint32_t) x + (uint32_t) (x >> 32);
+	    }
+	}
+      ref[ti * 4U + 2U] = cd_crc32 (0U, img + start * cd_sample_size, n * cd_sample_size);
+      ref[ti * 4U + 3U] = nz_crc (0U, img + start * cd_sample_size, n * cd_sample_size, &nz_len);
+    }
+
+  for (int pass = 0; (CD_OK == ret) && (pass < 2); pass++)
+    {
+      cd_accurip_t *acc = cd_accurip_new (&plan);
+      const double t0 = cd_clock ();
+
+      if (NULL == acc)
+	{
+	  ret = CD_ERR_MEM;
+	  break;
+	}
+      if (0 == pass)
+	{
+	  // Runs, the zero edges first, the periods split unevenly
+	  const size_t split = 1234U;
+
+	  ret = cd_accurip_feed (acc, 0U, NULL, tracks[0].start * cd_sample_size, 1U);
+	  if (CD_OK == ret)
+	    {
+	      ret = cd_accurip_feed (acc, (tracks[0].start + pat_len * count) * cd_sample_size, NULL, 7U * cd_frame_size * cd_sample_size, 1U);
+	    }
+	  if (CD_OK == ret)
+	    {
+	      ret = cd_accurip_feed (acc, (tracks[0].start + split * pat_len) * cd_sample_size, pat, pat_len * cd_sample_size, count - split);
+	    }
+	  if (CD_OK == ret)
+	    {
+	      ret = cd_accurip_feed (acc, tracks[0].start * cd_sample_size, pat, pat_len * cd_sample_size, split);
+	    }
+	}
+      for (size_t off = size * cd_sample_size; (CD_OK == ret) && (1 == pass) && (0U < off);)
+	{
+	  // Rendered, back to front
+	  const size_t len = (off < 4U * 65537U) ? off : (4U * 65537U);
+
+	  off -= len;
+	  ret = cd_accurip_feed (acc, off, img + off, len, 1U);
+	}
+      if (CD_OK == ret)
+	{
+	  ret = accurip_finish (acc, sums[pass]);
+	}
+      t[pass] = cd_clock () - t0;
+      cd_accurip_free (acc);
+
+      if ((CD_OK == ret) && (0 != memcmp (ref, sums[pass], sizeof (ref))))
+	{
+	  fprintf (stderr, "accurip %s: mismatch!\n\n", pass ? "rendered" : "periodic");
+	  ret = CD_ERR_ARG;
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      fprintf (out, "accurip periodic: ok %8.3f ms, rendered %8.3f ms, %lu samples\n", t[0] * 1e3, t[1] * 1e3, (unsigned long) size);
+    }
+
+  free (img);
+  free (pat);
+
+  return ret;
+}
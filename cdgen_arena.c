@@ -0,0 +1,106 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Bump allocator for the strings and arrays of one plan.  Blocks are
+    chained and released together, nothing is freed on its own.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+
+#include "cdgen_int.h"
+
+#define ARENA_BLOCK (16384U)	// Bytes per block, larger requests get their own
+
+struct cd_arena_blk
+{
+  struct cd_arena_blk *next;
+  size_t used;
+  size_t size;
+  max_align_t data[];
+};
+
+void *
+cd_arena_alloc (cd_arena_t * arena, size_t size)
+{
+  void *ret = NULL;
+  const size_t align = sizeof (max_align_t);
+  struct cd_arena_blk *blk = arena->head;
+
+  size = (size + align - 1U) / align * align;
+  if ((NULL == blk) || (blk->size - blk->used < size))
+    {
+      const size_t blk_size = (ARENA_BLOCK < size) ? size : ARENA_BLOCK;
+
+      blk = malloc (sizeof (*blk) + blk_size);
+      if (blk)
+	{
+	  blk->used = 0U;
+	  blk->size = blk_size;
+	  // A large request gets its own block behind the current one, which keeps its room
+	  if (arena->head && (ARENA_BLOCK < size))
+	    {
+	      blk->next = arena->head->next;
+	      arena->head->next = blk;
+	    }
+	  else
+	    {
+	      blk->next = arena->head;
+	      arena->head = blk;
+	    }
+	}
+      else
+	{
+	  fprintf (stderr, "Memory allocation error(arena): %s!\n\n", strerror (errno));
+	}
+    }
+  if (blk)
+    {
+      ret = (uint8_t *) blk->data + blk->used;
+      blk->used += size;
+    }
+
+  return ret;
+}
+
+char *
+cd_arena_strdup (cd_arena_t * arena, const char *str)
+{
+  const size_t len = strlen (str) + 1U;
+  char *ret = cd_arena_alloc (arena, len);
+
+  if (ret)
+    {
+      memcpy (ret, str, len);
+    }
+
+  return ret;
+}
+
+void
+cd_arena_free (cd_arena_t * arena)
+{
+  while (arena->head)
+    {
+      struct cd_arena_blk *next = arena->head->next;
+      free (arena->head);
+      arena->head = next;
+    }
+}
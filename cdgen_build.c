@@ -0,0 +1,268 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Incremental rebuilds.  With -i a build leaves <base>.build next to
+    the images: one line per image property and one per track with its
+    generator parameters and offsets.  The next build compares its plan
+    with it and renders only the tracks whose line differs into the
+    existing images.  A different version, size, output or format list
+    rebuilds everything.
+
+    With -m the build also leaves <base>.manifest: the same track lines
+    and the CRC32, MD5 and SHA-256 of each image and of each track in
+    it, hashed while the images were written.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "cdgen_int.h"
+
+#define BUILD_VERSION (1)
+#define MANIFEST_VERSION (1)
+
+static void build_track (FILE * out, const cd_plan_t * plan, size_t ti);
+static void manifest_digest (FILE * out, const cd_digest_t * digest);
+static char *build_text (const cd_plan_t * plan, const cd_options_t * opt);
+static char *build_read (const char *path);
+
+/* Generator parameters and offsets of one track */
+static void
+build_track (FILE * out, const cd_plan_t * plan, size_t ti)
+{
+  const cd_plan_track_t *pt = &plan->tracks[ti];
+  const cd_track_t *trk = pt->trk;
+
+  fprintf (out, "track %lu %s length=%lu pregap=%lu period=%lu carrier=%lu steps=%lu ratio=%lu strips=%lu seed=%u begin=%lu start=%lu end=%lu\n",
+	   (unsigned long) ti + 1UL, cd_gen_get (trk->type)->name, (unsigned long) trk->length, (unsigned long) trk->pregap,
+	   (unsigned long) trk->period, (unsigned long) trk->carrier, (unsigned long) trk->steps, (unsigned long) trk->ratio,
+	   (unsigned long) trk->strips, trk->seed, (unsigned long) pt->begin, (unsigned long) pt->start, (unsigned long) pt->end);
+}
+
+/* The sidecar contents for plan, NULL on allocation failure */
+static char *
+build_text (const cd_plan_t * plan, const cd_options_t * opt)
+{
+  char *ret = NULL;
+  size_t len = 0U;
+  FILE *out = open_memstream (&ret, &len);
+
+  if (out)
+    {
+      fprintf (out, "cdgen build v%d render v%d\n", BUILD_VERSION, CD_RENDER_VERSION);
+      fprintf (out, "size %lu\n", (unsigned long) plan->size);
+      fprintf (out, "output %s\n", opt->output ? opt->output : "");
+      fprintf (out, "formats");
+      for (size_t fi = 0U; fi < opt->format_num; fi++)
+	{
+	  fprintf (out, " %s", cd_format_find (opt->format[fi])->name);
+	}
+      fprintf (out, "%s\n", opt->format_num ? "" : " cdr");
+
+      for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+	{
+	  build_track (out, plan, ti);
+	}
+
+      if (0 != fclose (out))
+	{
+	  free (ret);
+	  ret = NULL;
+	}
+    }
+  if (NULL == ret)
+    {
+      fprintf (stderr, "Memory allocation error(build): %s!\n\n", strerror (errno));
+    }
+
+  return ret;
+}
+
+/* Whole file as a string, NULL if missing or unreadable */
+static char *
+build_read (const char *path)
+{
+  char *ret = NULL;
+  FILE *in = fopen (path, "rt");
+  long size = -1;
+
+  if (in && (0 == fseek (in, 0L, SEEK_END)))
+    {
+      size = ftell (in);
+    }
+  if ((0 <= size) && (0 == fseek (in, 0L, SEEK_SET)))
+    {
+      ret = malloc ((size_t) size + 1U);
+    }
+  if (ret)
+    {
+      if ((size_t) size == fread (ret, 1U, (size_t) size, in))
+	{
+	  ret[size] = '\0';
+	}
+      else
+	{
+	  free (ret);
+	  ret = NULL;
+	}
+    }
+  if (in)
+    {
+      fclose (in);
+    }
+
+  return ret;
+}
+
+/*
+    Compare plan with the previous build at path.  Returns CD_OK when the
+    images can be updated in place, with changed[] set for the tracks to
+    render, CD_ERR_FILE when everything has to be rebuilt.
+*/
+int
+cd_build_changed (const char *path, const cd_plan_t * plan, const cd_options_t * opt, uint8_t * changed)
+{
+  int ret = CD_ERR_FILE;
+  char *old = build_read (path);
+  char *text = build_text (plan, opt);
+  char *line = text ? strstr (text, "\ntrack ") : NULL;
+  const size_t header_len = line ? (size_t) (line - text) + 1U : 0U;
+
+  if (NULL == old)
+    {
+      fprintf (stderr, CD_WARN "%s: no previous build, rebuilding all\n", path);
+    }
+  else if ((NULL == line) || (0 != strncmp (old, text, header_len)))
+    {
+      fprintf (stderr, CD_WARN "%s: version, size, output or formats differ, rebuilding all\n", path);
+    }
+  else
+    {
+      ret = CD_OK;
+    }
+
+  // Each track line, with the newline in front, either appears verbatim in the old build or the track changed
+  for (size_t ti = 0U; (CD_OK == ret) && (ti < plan->tracks_num); ti++)
+    {
+      char *next = strchr (line + 1, '\n');
+      const char saved = next[1];
+
+      next[1] = '\0';
+      changed[ti] = (NULL == strstr (old + header_len - 1U, line));
+      next[1] = saved;
+      line = next;
+    }
+
+  free (text);
+  free (old);
+
+  return ret;
+}
+
+/* Record plan as the build now in the images, replaced atomically */
+int
+cd_build_store (const char *path, const cd_plan_t * plan, const cd_options_t * opt)
+{
+  int ret = CD_OK;
+  char *text = build_text (plan, opt);
+  char *tmp = cd_make_name (path, ".tmp");
+  FILE *out = (text && tmp) ? fopen (tmp, "wt") : NULL;
+
+  if (NULL == out)
+    {
+      fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      ret = (EOF == fputs (text, out)) ? CD_ERR_FILE : CD_OK;
+      if ((0 != fclose (out)) || (CD_OK != ret) || (0 != rename (tmp, path)))
+	{
+	  fprintf (stderr, "Write error (build): %s!\n\n", strerror (errno));
+	  unlink (tmp);
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  free (tmp);
+  free (text);
+
+  return ret;
+}
+
+static void
+manifest_digest (FILE * out, const cd_digest_t * digest)
+{
+  char md5[2U * sizeof (digest->md5) + 1U];
+  char sha256[2U * sizeof (digest->sha256) + 1U];
+
+  cd_digest_hex (digest->md5, sizeof (digest->md5), md5);
+  cd_digest_hex (digest->sha256, sizeof (digest->sha256), sha256);
+  fprintf (out, " crc32=%08x md5=%s sha256=%s\n", digest->crc32, md5, sha256);
+}
+
+/* Write the manifest of the images just built, replaced atomically */
+int
+cd_manifest_store (const char *path, const cd_plan_t * plan, const cd_manifest_image_t * images, size_t images_num)
+{
+  int ret = CD_OK;
+  char *tmp = cd_make_name (path, ".tmp");
+  FILE *out = tmp ? fopen (tmp, "wt") : NULL;
+
+  if (NULL == out)
+    {
+      fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      fprintf (out, "cdgen manifest v%d render v%d\n", MANIFEST_VERSION, CD_RENDER_VERSION);
+      for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+	{
+	  build_track (out, plan, ti);
+	}
+      for (size_t ii = 0U; ii < images_num; ii++)
+	{
+	  const cd_manifest_image_t *img = &images[ii];
+
+	  fprintf (out, "image %s %s bytes=%lu", img->name, img->format, (unsigned long) img->size);
+	  manifest_digest (out, &img->digests[0]);
+	  for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+	    {
+	      const cd_plan_track_t *pt = &plan->tracks[ti];
+
+	      fprintf (out, "image %s track %lu offset=%lu bytes=%lu", img->name, (unsigned long) ti + 1UL,
+		       (unsigned long) (img->data_offset + pt->begin * cd_sample_size), (unsigned long) ((pt->end - pt->begin) * cd_sample_size));
+	      manifest_digest (out, &img->digests[ti + 1U]);
+	    }
+	}
+
+      if ((0 != fclose (out)) || (0 != rename (tmp, path)))
+	{
+	  fprintf (stderr, "Write error (manifest): %s!\n\n", strerror (errno));
+	  unlink (tmp);
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  free (tmp);
+
+  return ret;
+}
@@ -0,0 +1,188 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    On-disk period cache.  One file per rendered period, named after the
+    generator parameters, holding a CACHE_HEADER byte text header with
+    the full key and the period samples behind it, page aligned so the
+    file is mapped and handed to the sink as it is.  Files are written
+    to a temporary name and renamed, so concurrent runs sharing a
+    directory see whole files only.  CD_RENDER_VERSION is part of the
+    key.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cdgen_int.h"
+
+#define CACHE_HEADER (4096U)
+
+static int cache_key (const cd_track_t * trk, size_t len, char *key, size_t key_size);
+static char *cache_path (const char *dir, const cd_track_t * trk, const char *suffix);
+
+/* Create the cache directory if needed, without it periods are just rendered */
+int
+cd_cache_open (const char *dir)
+{
+  int ret = CD_OK;
+
+  if ((0 != mkdir (dir, 0755)) && (EEXIST != errno))
+    {
+      fprintf (stderr, CD_WARN "cache %s: %s\n", dir, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+
+  return ret;
+}
+
+/* Key line, everything the rendered samples depend on */
+static int
+cache_key (const cd_track_t * trk, size_t len, char *key, size_t key_size)
+{
+  const int n = snprintf (key, key_size, "cdgen period v%d %s s16 stereo %s period=%lu carrier=%lu steps=%lu ratio=%lu len=%lu\n",
+			  CD_RENDER_VERSION, (CD_ORDER_BE == CD_HOST_ORDER) ? "be" : "le", cd_gen_get (trk->type)->name,
+			  (unsigned long) trk->period, (unsigned long) trk->carrier, (unsigned long) trk->steps,
+			  (unsigned long) trk->ratio, (unsigned long) len);
+
+  return ((0 < n) && ((size_t) n < key_size)) ? CD_OK : CD_ERR_ARG;
+}
+
+static char *
+cache_path (const char *dir, const cd_track_t * trk, const char *suffix)
+{
+  char name[160];
+
+  snprintf (name, sizeof (name), "/%s-%lu-%lu-%lu-%lu-v%d-%s.pcm%s", cd_gen_get (trk->type)->name, (unsigned long) trk->period,
+	    (unsigned long) trk->carrier, (unsigned long) trk->steps, (unsigned long) trk->ratio, CD_RENDER_VERSION,
+	    (CD_ORDER_BE == CD_HOST_ORDER) ? "be" : "le", suffix);
+
+  return cd_make_name (dir, name);
+}
+
+/*
+    Map the cached period of trk, len samples.  Returns CD_OK with *sam
+    pointing into the mapping, CD_ERR_FILE when there is no valid entry.
+*/
+int
+cd_cache_load (const char *dir, const cd_track_t * trk, size_t len, sample_t ** sam, void **map, size_t *map_len)
+{
+  int ret = CD_ERR_FILE;
+  char key[CACHE_HEADER];
+  char *path = cache_path (dir, trk, "");
+  int fd = path ? open (path, O_RDONLY) : -1;
+  struct stat st;
+
+  if ((0 <= fd) && (0 == fstat (fd, &st)) && ((off_t) (CACHE_HEADER + len * sizeof (sample_t)) == st.st_size)
+      && (CD_OK == cache_key (trk, len, key, sizeof (key))))
+    {
+      void *addr = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+      if (MAP_FAILED == addr)
+	{
+	  fprintf (stderr, CD_WARN "cache %s: %s\n", path, strerror (errno));
+	}
+      else if ((0 != memcmp (addr, key, strlen (key) + 1U)))
+	{
+	  fprintf (stderr, CD_WARN "cache %s: key mismatch, rendering\n", path);
+	  munmap (addr, (size_t) st.st_size);
+	}
+      else
+	{
+	  madvise (addr, (size_t) st.st_size, MADV_WILLNEED);
+	  *sam = (sample_t *) ((uint8_t *) addr + CACHE_HEADER);
+	  *map = addr;
+	  *map_len = (size_t) st.st_size;
+	  ret = CD_OK;
+	}
+    }
+
+  if (0 <= fd)
+    {
+      close (fd);
+    }
+  free (path);
+
+  return ret;
+}
+
+/* Store a rendered period, best effort, a failure only costs the next run a render */
+int
+cd_cache_store (const char *dir, const cd_track_t * trk, const sample_t * sam, size_t len)
+{
+  int ret = CD_OK;
+  char header[CACHE_HEADER];
+  char suffix[64];
+  char *path = cache_path (dir, trk, "");
+  char *tmp = NULL;
+  int fd = -1;
+
+  memset (header, 0, sizeof (header));
+  snprintf (suffix, sizeof (suffix), ".%ld.%lu", (long) getpid (), (unsigned long) pthread_self ());
+  tmp = cache_path (dir, trk, suffix);
+  ret = (path && tmp) ? cache_key (trk, len, header, sizeof (header)) : CD_ERR_MEM;
+
+  if (CD_OK == ret)
+    {
+      fd = open (tmp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+      if (0 > fd)
+	{
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  for (size_t done = 0U; (CD_OK == ret) && (done < sizeof (header));)
+    {
+      const ssize_t n = write (fd, header + done, sizeof (header) - done);
+      ret = (0 < n) ? CD_OK : CD_ERR_FILE;
+      done += (0 < n) ? (size_t) n : 0U;
+    }
+  for (size_t done = 0U; (CD_OK == ret) && (done < len * sizeof (sample_t));)
+    {
+      const ssize_t n = write (fd, (const uint8_t *) sam + done, len * sizeof (sample_t) - done);
+      ret = (0 < n) ? CD_OK : CD_ERR_FILE;
+      done += (0 < n) ? (size_t) n : 0U;
+    }
+
+  if ((0 <= fd) && (0 != close (fd)) && (CD_OK == ret))
+    {
+      ret = CD_ERR_FILE;
+    }
+  if ((CD_OK == ret) && (0 != rename (tmp, path)))
+    {
+      ret = CD_ERR_FILE;
+    }
+  if (CD_ERR_FILE == ret)
+    {
+      fprintf (stderr, CD_WARN "cache %s: %s\n", tmp, strerror (errno));
+      if (0 <= fd)
+	{
+	  unlink (tmp);
+	}
+    }
+
+  free (tmp);
+  free (path);
+
+  return ret;
+}
@@ -0,0 +1,238 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Image containers.  The header is computed from the planned data size
+    and written before any track, so no pass over the image is needed
+    afterwards.
+
+    cdr   headerless big endian samples (cdrdao)
+    wav   RIFF WAVE, little endian
+    rf64  EBU RF64 WAVE for data beyond 4 GB, little endian
+    aiff  AIFF, big endian
+    bin   headerless little endian samples (emulators, BINARY in the CUE)
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cdgen_int.h"
+
+#define FORMAT_HEADER_MAX (80U)
+
+static size_t header_wav (uint8_t * hdr, size_t data_size);
+static size_t header_rf64 (uint8_t * hdr, size_t data_size);
+static size_t header_aiff (uint8_t * hdr, size_t data_size);
+static uint8_t *put_le (uint8_t * p, uint64_t v, size_t bytes);
+static uint8_t *put_be (uint8_t * p, uint64_t v, size_t bytes);
+static uint8_t *put_tag (uint8_t * p, const char *tag);
+static uint8_t *put_fmt (uint8_t * p);
+
+// The TOC and CUE of cdr images have always referenced <base>.wav
+static const cd_format_t formats[] = {
+  {"cdr", ".cdr", ".wav", "WAVE", CD_ORDER_BE, 0U, NULL},
+  {"wav", ".wav", ".wav", "WAVE", CD_ORDER_LE, 44U, header_wav},
+  {"rf64", ".wav", ".wav", "WAVE", CD_ORDER_LE, 80U, header_rf64},
+  {"aiff", ".aiff", ".aiff", "AIFF", CD_ORDER_BE, 54U, header_aiff},
+  {"bin", ".bin", ".bin", "BINARY", CD_ORDER_LE, 0U, NULL},
+};
+
+const cd_format_t *
+cd_format_find (const char *name)
+{
+  const cd_format_t *ret = NULL;
+
+  for (size_t fi = 0U; (NULL == ret) && (fi < sizeof (formats) / sizeof (formats[0])); fi++)
+    {
+      if (0 == strcmp (name, formats[fi].name))
+	{
+	  ret = &formats[fi];
+	}
+    }
+
+  return ret;
+}
+
+/* Container for data_size bytes of audio, wav turns into rf64 beyond 4 GB */
+const cd_format_t *
+cd_format_for (const char *name, size_t data_size)
+{
+  const cd_format_t *ret = cd_format_find (name ? name : "cdr");
+
+  if (ret && (header_wav == ret->header) && ((uint64_t) data_size > (uint64_t) UINT32_MAX - 36U))
+    {
+      fprintf (stderr, CD_WARN "%lu data bytes do not fit RIFF, writing RF64\n", data_size);
+      ret = cd_format_find ("rf64");
+    }
+
+  return ret;
+}
+
+/* Container of an existing image, from its extension, cdr if unknown */
+const cd_format_t *
+cd_format_of (const char *path, size_t data_size)
+{
+  const char *name = NULL;
+  const size_t path_len = strlen (path);
+
+  for (size_t fi = 0U; (NULL == name) && (fi < sizeof (formats) / sizeof (formats[0])); fi++)
+    {
+      const size_t ext_len = strlen (formats[fi].ext);
+
+      if ((ext_len <= path_len) && (0 == strcmp (path + path_len - ext_len, formats[fi].ext)))
+	{
+	  name = formats[fi].name;
+	}
+    }
+
+  return cd_format_for (name, data_size);
+}
+
+int
+cd_format_header (const cd_format_t * fmt, cd_image_t * img, size_t data_size)
+{
+  int ret = CD_OK;
+  uint8_t hdr[FORMAT_HEADER_MAX];
+
+  if (fmt->header)
+    {
+      const size_t len = fmt->header (hdr, data_size);
+      ret = img->ops->write_at (img, 0U, hdr, len);
+      if (CD_OK == ret)
+	{
+	  ret = cd_image_feed (img, 0U, hdr, len, 1U);
+	}
+    }
+
+  return ret;
+}
+
+static uint8_t *
+put_le (uint8_t * p, uint64_t v, size_t bytes)
+{
+  for (size_t bi = 0U; bi < bytes; bi++)
+    {
+      *p++ = (uint8_t) (v >> (8U * bi));
+    }
+
+  return p;
+}
+
+static uint8_t *
+put_be (uint8_t * p, uint64_t v, size_t bytes)
+{
+  for (size_t bi = bytes; 0U < bi; bi--)
+    {
+      *p++ = (uint8_t) (v >> (8U * (bi - 1U)));
+    }
+
+  return p;
+}
+
+static uint8_t *
+put_tag (uint8_t * p, const char *tag)
+{
+  memcpy (p, tag, 4U);
+
+  return p + 4U;
+}
+
+/* WAVE fmt chunk, 16 bit stereo PCM at cd_fd */
+static uint8_t *
+put_fmt (uint8_t * p)
+{
+  p = put_tag (p, "fmt ");
+  p = put_le (p, 16U, 4U);
+  p = put_le (p, 1U, 2U);
+  p = put_le (p, 2U, 2U);
+  p = put_le (p, (uint64_t) cd_fd, 4U);
+  p = put_le (p, (uint64_t) cd_fd * cd_sample_size, 4U);
+  p = put_le (p, (uint64_t) cd_sample_size, 2U);
+  p = put_le (p, 16U, 2U);
+
+  return p;
+}
+
+static size_t
+header_wav (uint8_t * hdr, size_t data_size)
+{
+  uint8_t *p = hdr;
+
+  p = put_tag (p, "RIFF");
+  p = put_le (p, 36U + (uint64_t) data_size, 4U);
+  p = put_tag (p, "WAVE");
+  p = put_fmt (p);
+  p = put_tag (p, "data");
+  p = put_le (p, data_size, 4U);
+
+  return (size_t) (p - hdr);
+}
+
+/* RIFF and data sizes are 0xFFFFFFFF, the real ones are in ds64 */
+static size_t
+header_rf64 (uint8_t * hdr, size_t data_size)
+{
+  uint8_t *p = hdr;
+
+  p = put_tag (p, "RF64");
+  p = put_le (p, UINT32_MAX, 4U);
+  p = put_tag (p, "WAVE");
+  p = put_tag (p, "ds64");
+  p = put_le (p, 28U, 4U);
+  p = put_le (p, 72U + (uint64_t) data_size, 8U);
+  p = put_le (p, data_size, 8U);
+  p = put_le (p, data_size / cd_sample_size, 8U);
+  p = put_le (p, 0U, 4U);
+  p = put_fmt (p);
+  p = put_tag (p, "data");
+  p = put_le (p, UINT32_MAX, 4U);
+
+  return (size_t) (p - hdr);
+}
+
+/* COMM carries the rate as an 80 bit extended float, 44100 is 0x400E AC44 0... */
+static size_t
+header_aiff (uint8_t * hdr, size_t data_size)
+{
+  uint8_t *p = hdr;
+  uint64_t mantissa = (uint64_t) cd_fd;
+  unsigned int exponent = 16383U + 63U;
+
+  while (0U == (mantissa & (1ULL << 63)))
+    {
+      mantissa <<= 1;
+      exponent--;
+    }
+
+  p = put_tag (p, "FORM");
+  p = put_be (p, 46U + (uint64_t) data_size, 4U);
+  p = put_tag (p, "AIFF");
+  p = put_tag (p, "COMM");
+  p = put_be (p, 18U, 4U);
+  p = put_be (p, 2U, 2U);
+  p = put_be (p, data_size / cd_sample_size, 4U);
+  p = put_be (p, 16U, 2U);
+  p = put_be (p, exponent, 2U);
+  p = put_be (p, mantissa, 8U);
+  p = put_tag (p, "SSND");
+  p = put_be (p, 8U + (uint64_t) data_size, 4U);
+  p = put_be (p, 0U, 4U);
+  p = put_be (p, 0U, 4U);
+
+  return (size_t) (p - hdr);
+}
@@ -0,0 +1,789 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include "cdgen_int.h"
+
+/*
+    Sines follow the generators' phase accumulator a block of SINE_BLOCK
+    samples at a time: the phases are accumulated first, then evaluated
+    together by cd_sincos().  Where a value lands within SINE_GUARD of a
+    16 bit code boundary the caller evaluates it with libm instead, so
+    the codes are the same as with sin() on every sample.  exact uses
+    libm throughout, the reference for the checks.
+*/
+#define SINE_BLOCK (256U)
+#define SINE_GUARD (1e-4)
+
+#define NOISE_BLOCK (1U << 18)	// Samples per random() fill, each starts with a seek
+
+static const char *filter_note (const double freq);
+static void check_symmetry (const sample_t * sam, size_t len);
+static double sine_block (double radpos, double step, double mul, double *pos, double *s, double *c, size_t n, int exact);
+static int code_safe (double val);
+static void sine_halves (sample_t * sam, size_t halflen, size_t warn_i, int exact);
+
+static size_t period_plain (const cd_track_t * trk);
+static size_t period_fm_step (const cd_track_t * trk);
+
+static int tone (const cd_track_t * trk, sample_t * sam, size_t len, int exact);
+static int am_sine (const cd_track_t * trk, sample_t * sam, size_t len, int exact);
+static int am_triangle (const cd_track_t * trk, sample_t * sam, size_t len, int exact);
+static int fm_step (const cd_track_t * trk, sample_t * sam, size_t len, int exact);
+
+static int render_tone (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_tone_libm (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_square (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_pulse (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_triangle (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_am_sine (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_am_sine_libm (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_am_triangle (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_am_triangle_libm (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_fm_step (const cd_track_t * trk, sample_t * sam, size_t len);
+static int render_fm_step_libm (const cd_track_t * trk, sample_t * sam, size_t len);
+static int stream_silence (const cd_track_t * trk, cd_sink_t * sink);
+static int render_at_noise (const cd_track_t * trk, size_t pos, sample_t * sam, size_t len);
+static int render_at_philox (const cd_track_t * trk, size_t pos, sample_t * sam, size_t len);
+
+static size_t indexes_silence (const cd_track_t * trk, size_t * idx, size_t max);
+
+static void describe_tone (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_square (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_pulse (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_triangle (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_am_sine (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_am_triangle (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_fm_step (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_noise (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_silence (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void describe_philox (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+static void remark_philox (const cd_track_t * trk, char *rem, size_t rem_size);
+
+static const cd_gen_t generators[CD_GEN_NUM] = {
+  [CD_GEN_TONE] = {"tone", period_plain, render_tone, NULL, NULL, describe_tone, render_tone_libm},
+  [CD_GEN_SQUARE] = {"square", period_plain, render_square, NULL, NULL, describe_square},
+  [CD_GEN_PULSE] = {"pulse", period_plain, render_pulse, NULL, NULL, describe_pulse},
+  [CD_GEN_TRIANGLE] = {"triangle", period_plain, render_triangle, NULL, NULL, describe_triangle},
+  [CD_GEN_AM_SINE] = {"am_sine", period_plain, render_am_sine, NULL, NULL, describe_am_sine, render_am_sine_libm},
+  [CD_GEN_AM_TRIANGLE] = {"am_triangle", period_plain, render_am_triangle, NULL, NULL, describe_am_triangle, render_am_triangle_libm},
+  [CD_GEN_FM_STEP] = {"fm_step", period_fm_step, render_fm_step, NULL, NULL, describe_fm_step, render_fm_step_libm},
+  [CD_GEN_NOISE] = {"noise", NULL, NULL, NULL, NULL, describe_noise, NULL, render_at_noise},
+  [CD_GEN_SILENCE] = {"silence", NULL, NULL, stream_silence, indexes_silence, describe_silence},
+  [CD_GEN_PHILOX] = {"philox", NULL, NULL, NULL, NULL, describe_philox, NULL, render_at_philox, remark_philox},
+};
+
+const cd_gen_t *
+cd_gen_get (cd_gen_type_t type)
+{
+  const cd_gen_t *ret = NULL;
+
+  if ((0 <= (int) type) && (CD_GEN_NUM > type))
+    {
+      ret = &generators[type];
+    }
+
+  return ret;
+}
+
+int
+cd_gen_find (const char *name, cd_gen_type_t * type)
+{
+  int ret = CD_ERR_ARG;
+
+  for (int gi = 0; (CD_OK != ret) && (CD_GEN_NUM > gi); gi++)
+    {
+      if (0 == strcmp (name, generators[gi].name))
+	{
+	  *type = (cd_gen_type_t) gi;
+	  ret = CD_OK;
+	}
+    }
+
+  return ret;
+}
+
+/*
+    Render the period of trk with the libm reference, then with render()
+    once per sin kernel the CPU supports, comparing every 16 bit code
+    and timing each.  Not thread safe, the kernel selection is global.
+*/
+int
+cd_gen_check (const cd_track_t * trk, FILE * out)
+{
+  int ret = CD_OK;
+  const cd_gen_t *gen = cd_gen_get (trk->type);
+  const size_t len = gen->period ? gen->period (trk) : 0U;
+  sample_t *fast = NULL;
+  sample_t *ref = NULL;
+
+  if ((NULL == gen->render_ref) || (0U == len))
+    {
+      return CD_OK;
+    }
+
+  fast = malloc (sizeof (sample_t) * len);
+  ref = malloc (sizeof (sample_t) * len);
+  if (fast && ref)
+    {
+      char name[64];
+      int pos = snprintf (name, sizeof (name), "%s period %lu", gen->name, (unsigned long) len);
+      if (trk->carrier)
+	{
+	  snprintf (name + pos, sizeof (name) - pos, " carrier %lu", (unsigned long) trk->carrier);
+	}
+
+      memset (fast, 0, sizeof (sample_t) * len);
+      const double t0 = cd_clock ();
+      ret = gen->render_ref (trk, ref, len);
+      fprintf (out, "%s: libm %.3f ms", name, (cd_clock () - t0) * 1e3);
+
+      for (size_t ki = 0U; (CD_OK == ret) && cd_sincos_kernel (ki); ki++)
+	{
+	  size_t bad = 0U;
+
+	  cd_sincos_use (cd_sincos_kernel (ki));
+	  const double t1 = cd_clock ();
+	  ret = gen->render (trk, fast, len);
+	  fprintf (out, ", %s %.3f ms", cd_sincos_kernel (ki), (cd_clock () - t1) * 1e3);
+
+	  for (size_t i = 0U; (CD_OK == ret) && (i < len); i++)
+	    {
+	      if ((fast[i].s.l != ref[i].s.l) || (fast[i].s.r != ref[i].s.r))
+		{
+		  if (bad < 10U)
+		    {
+		      fprintf (out, "\n%s: %s sample %lu is %d/%d, libm %d/%d", name, cd_sincos_kernel (ki), (unsigned long) i,
+			       (int16_t) fast[i].s.l, (int16_t) fast[i].s.r, (int16_t) ref[i].s.l, (int16_t) ref[i].s.r);
+		    }
+		  bad++;
+		}
+	    }
+	  if (0U < bad)
+	    {
+	      fprintf (out, "\n%s: %s %lu mismatches", name, cd_sincos_kernel (ki), (unsigned long) bad);
+	      ret = CD_ERR_ARG;
+	    }
+	}
+      fprintf (out, "%s\n", (CD_OK == ret) ? ", all match" : "");
+      cd_sincos_use (NULL);
+    }
+  else
+    {
+      fprintf (stderr, "Memory allocation error(check): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  free (ref);
+  free (fast);
+
+  return ret;
+}
+
+static const char *
+filter_note (const double freq)
+{
+  return (2.01 < ((double) cd_fd / freq)) ? "" : " (Frequency outside filter range)";
+}
+
+static void
+check_symmetry (const sample_t * sam, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    {
+      if (-1 != ((int) ((int16_t) sam[i].s.l) + (int) ((int16_t) sam[len - i - 1].s.l)))
+	{
+	  fprintf (stderr, CD_WARN "Values are not symmetrical to neutral level 0.5: i=%d val1=%5d val2=%5d\n", (int) i, (int) ((int16_t) sam[i].s.l),
+		   (int) ((int16_t) sam[len - i - 1].s.l));
+	}
+    }
+}
+
+/*
+    Phases of the next n samples from radpos into pos, sin and cos of
+    pos * mul into s and c (either may be NULL).  Returns the phase of
+    the sample after the block.
+*/
+static double
+sine_block (double radpos, double step, double mul, double *pos, double *s, double *c, size_t n, int exact)
+{
+  double arg[SINE_BLOCK];
+
+  for (size_t i = 0U; i < n; i++)
+    {
+      pos[i] = radpos;
+      arg[i] = radpos * mul;
+      radpos += step;
+    }
+
+  if (exact)
+    {
+      for (size_t i = 0U; i < n; i++)
+	{
+	  if (s)
+	    {
+	      s[i] = sin (arg[i]);
+	    }
+	  if (c)
+	    {
+	      c[i] = cos (arg[i]);
+	    }
+	}
+    }
+  else
+    {
+      cd_sincos (arg, s, c, n);
+    }
+
+  return radpos;
+}
+
+/* val truncates to the same code when off by less than SINE_GUARD */
+static int
+code_safe (double val)
+{
+  const double frac = val - floor (val);
+
+  return (SINE_GUARD < frac) && ((1.0 - SINE_GUARD) > frac);
+}
+
+/* Sine period of 2 * halflen samples, negative half mirrored */
+static void
+sine_halves (sample_t * sam, size_t halflen, size_t warn_i, int exact)
+{
+  const int base_i = 0x8000;
+  const double base_d = (double) base_i;
+  const double half_d = 0.5;
+  double radpos = M_PI / (double) halflen / 2.0;
+  double pos[SINE_BLOCK];
+  double sv[SINE_BLOCK];
+
+  for (size_t i = 0; i < halflen; i++)
+    {
+      const size_t bi = i % SINE_BLOCK;
+      if (0U == bi)
+	{
+	  const size_t n = (SINE_BLOCK < halflen - i) ? SINE_BLOCK : (halflen - i);
+	  radpos = sine_block (radpos, M_PI / halflen, 1.0, pos, sv, NULL, n, exact);
+	}
+
+      double dval = sv[bi] * (base_d - half_d);
+      if (!code_safe (dval + base_d) || !code_safe (-dval + base_d))
+	{
+	  dval = sin (pos[bi]) * (base_d - half_d);
+	}
+      double dval_neg = -dval;
+      int val1 = (int) (dval + base_d);
+      int val2 = (int) (dval_neg + base_d);
+      val1 -= base_i;
+      val2 -= base_i;
+      if (-1 != (val1 + val2))
+	{
+	  fprintf (stderr, CD_WARN "Values are not symmetrical to neutral level 0.5: i=%d val1=%5d val2=%5d\n", (int) (warn_i + i), val1, val2);
+	}
+
+      sam[i].s.l = (uint16_t) val1;
+      sam[i + halflen].s.l = (uint16_t) val2;
+      sam[i].s.r = (uint16_t) val1;
+      sam[i + halflen].s.r = (uint16_t) val2;
+    }
+}
+
+static size_t
+period_plain (const cd_track_t * trk)
+{
+  return trk->period;
+}
+
+static size_t
+period_fm_step (const cd_track_t * trk)
+{
+  return trk->period * (trk->steps - 1U) * 2U;
+}
+
+static int
+tone (const cd_track_t * trk, sample_t * sam, size_t len, int exact)
+{
+  (void) trk;
+
+  sine_halves (sam, len / 2U, 0U, exact);
+
+  return CD_OK;
+}
+
+static int
+render_tone (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return tone (trk, sam, len, 0);
+}
+
+static int
+render_tone_libm (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return tone (trk, sam, len, 1);
+}
+
+static int
+render_square (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  (void) trk;
+  const size_t halflen = len / 2U;
+
+  for (size_t i = 0U; i < halflen; i++)
+    {
+      int val1 = 0X7FFF;
+      int val2 = -val1 - 1;
+
+      sam[i].s.l = (uint16_t) val1;
+      sam[i + halflen].s.l = (uint16_t) val2;
+      sam[i].s.r = (uint16_t) val1;
+      sam[i + halflen].s.r = (uint16_t) val2;
+    }
+
+  return CD_OK;
+}
+
+static int
+render_pulse (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  (void) trk;
+  const size_t halflen = len / 2U;
+
+  for (size_t i = 0U; i < halflen; i++)
+    {
+      int val1 = 0;
+      if (0U == i)
+	{
+	  val1 = 0X7FFF;
+	}
+      int val2 = -val1 - 1;
+
+      sam[i].s.l = (uint16_t) val1;
+      sam[i + halflen].s.l = (uint16_t) val2;
+      sam[i].s.r = (uint16_t) val1;
+      sam[i + halflen].s.r = (uint16_t) val2;
+    }
+
+  return CD_OK;
+}
+
+static int
+render_triangle (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  (void) trk;
+  const size_t half_len = len / 2U;
+  const int step = (int) (0x10000U / half_len);
+  int val = -(0x8000);
+
+  val += (int) (0x10000U / len);
+  for (size_t i = 0U; i < half_len; i++)
+    {
+      sam[i].s.l = (uint16_t) val;
+      sam[i].s.r = (uint16_t) val;
+      val += step;
+    }
+  for (size_t i = half_len; i < len; i++)
+    {
+      val -= step;
+      sam[i].s.l = (uint16_t) val;
+      sam[i].s.r = (uint16_t) val;
+    }
+
+  return CD_OK;
+}
+
+static int
+am_sine (const cd_track_t * trk, sample_t * sam, size_t len, int exact)
+{
+  const size_t halflen = len / 2U;
+  const double carr_div_d = (double) trk->carrier;
+  const int base_i = 0x8000;
+  const double base_d = (double) base_i;
+  double radpos = M_PI / halflen / 2;
+  double pos[SINE_BLOCK];
+  double carr_sv[SINE_BLOCK];
+  double env_cv[SINE_BLOCK];
+
+  for (size_t i = 0; i < len; i++)
+    {
+      const double half_d = 0.5;
+      const double one_d = 1.0;
+      const size_t bi = i % SINE_BLOCK;
+      if (0U == bi)
+	{
+	  const size_t n = (SINE_BLOCK < len - i) ? SINE_BLOCK : (len - i);
+	  sine_block (radpos, M_PI / halflen, carr_div_d, pos, carr_sv, NULL, n, exact);
+	  radpos = sine_block (radpos, M_PI / halflen, 1.0, pos, NULL, env_cv, n, exact);
+	}
+      double carr_dval = carr_sv[bi];
+      double carr_denv = (-env_cv[bi] + one_d) * half_d;
+
+      double dval = carr_denv * carr_dval * (base_d - half_d);
+      if (!code_safe (dval + base_d))
+	{
+	  carr_dval = sin (pos[bi] * carr_div_d);
+	  carr_denv = (-cos (pos[bi]) + one_d) * half_d;
+	  dval = carr_denv * carr_dval * (base_d - half_d);
+	}
+      int val1 = (int) (dval + base_d);
+      val1 -= base_i;
+
+      sam[i].s.l = (uint16_t) val1;
+      sam[i].s.r = (uint16_t) val1;
+    }
+
+  check_symmetry (sam, len);
+
+  return CD_OK;
+}
+
+static int
+render_am_sine (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return am_sine (trk, sam, len, 0);
+}
+
+static int
+render_am_sine_libm (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return am_sine (trk, sam, len, 1);
+}
+
+static int
+am_triangle (const cd_track_t * trk, sample_t * sam, size_t len, int exact)
+{
+  const size_t halflen = len / 2U;
+  const double carr_div_d = (double) trk->carrier;
+  const int base_i = 0x8000;
+  const double base_d = (double) base_i;
+  double radpos = M_PI / halflen / 2;
+  double pos[SINE_BLOCK];
+  double carr_sv[SINE_BLOCK];
+
+  for (size_t i = 0; i < len; i++)
+    {
+      const double half_d = 0.5;
+      const size_t bi = i % SINE_BLOCK;
+      if (0U == bi)
+	{
+	  const size_t n = (SINE_BLOCK < len - i) ? SINE_BLOCK : (len - i);
+	  radpos = sine_block (radpos, M_PI / halflen, carr_div_d, pos, carr_sv, NULL, n, exact);
+	}
+      double carr_dval = carr_sv[bi];
+      double carr_denv = 0.0;
+      if (halflen > i)
+	{
+	  carr_denv = ((double) i + half_d) / (double) halflen;
+	}
+      else
+	{
+	  carr_denv = ((double) (len - i - 1) + half_d) / (double) halflen;
+	}
+
+      double dval = carr_denv * carr_dval * (base_d - half_d);
+      if (!code_safe (dval + base_d))
+	{
+	  carr_dval = sin (pos[bi] * carr_div_d);
+	  dval = carr_denv * carr_dval * (base_d - half_d);
+	}
+      int val1 = (int) (dval + base_d);
+      val1 -= base_i;
+
+      sam[i].s.l = (uint16_t) val1;
+      sam[i].s.r = (uint16_t) val1;
+    }
+
+  check_symmetry (sam, len);
+
+  return CD_OK;
+}
+
+static int
+render_am_triangle (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return am_triangle (trk, sam, len, 0);
+}
+
+static int
+render_am_triangle_libm (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return am_triangle (trk, sam, len, 1);
+}
+
+static int
+fm_step (const cd_track_t * trk, sample_t * sam, size_t len, int exact)
+{
+  const size_t buf_len = trk->period;
+  const size_t buf_num = (trk->steps - 1U) * 2U;
+  size_t buf_ratio[buf_num];
+  size_t i = 0;
+  size_t ri = 0U;
+  size_t r = 1U;
+
+  memset (sam, 0, sizeof (sample_t) * len);
+
+  for (; trk->steps > ri; ri++)
+    {
+      buf_ratio[ri] = r;
+      r *= trk->ratio;
+    }
+  r /= trk->ratio;
+  for (; buf_num > ri; ri++)
+    {
+      r /= trk->ratio;
+      buf_ratio[ri] = r;
+    }
+
+  for (size_t buf_i = 0U; buf_num > buf_i; buf_i++)
+    {
+      size_t br = buf_ratio[buf_i];
+
+      for (size_t peri = 0; br > peri; peri++)
+	{
+	  size_t halflen = buf_len / br / 2U;
+
+	  sine_halves (sam + i, halflen, i, exact);
+	  i += 2U * halflen;
+	}
+    }
+
+  return CD_OK;
+}
+
+static int
+render_fm_step (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return fm_step (trk, sam, len, 0);
+}
+
+static int
+render_fm_step_libm (const cd_track_t * trk, sample_t * sam, size_t len)
+{
+  return fm_step (trk, sam, len, 1);
+}
+
+/*
+    Sample i of the body takes draws 2i and 2i + 1 of random() after
+    srandom (seed), the low 16 bits offset to signed, as the original
+    serial srandom()/random() loop did.
+*/
+static int
+render_at_noise (const cd_track_t * trk, size_t pos, sample_t * sam, size_t len)
+{
+  int ret = CD_OK;
+  const size_t buf_len = (len < NOISE_BLOCK) ? len : NOISE_BLOCK;
+  int32_t *rnd = malloc (2U * buf_len * sizeof (int32_t));
+
+  if (NULL == rnd)
+    {
+      fprintf (stderr, "Memory allocation error(data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  for (size_t i = 0U; (CD_OK == ret) && (i < len); i += buf_len)
+    {
+      const size_t n = (len - i < buf_len) ? (len - i) : buf_len;
+
+      cd_glibc_fill (trk->seed, 2U * (uint64_t) (pos + i), rnd, 2U * n);
+      for (size_t k = 0U; k < n; k++)
+	{
+	  sam[i + k].s.l = (uint16_t) ((int) (0xFFFF & rnd[2U * k]) - 0x8000);
+	  sam[i + k].s.r = (uint16_t) ((int) (0xFFFF & rnd[2U * k + 1U]) - 0x8000);
+	}
+    }
+
+  free (rnd);
+
+  return ret;
+}
+
+/*
+    Sample i of the body is word i % 4 of the Philox block at counter
+    i / 4 keyed by the seed, left channel in the low half.
+*/
+static int
+render_at_philox (const cd_track_t * trk, size_t pos, sample_t * sam, size_t len)
+{
+  const uint32_t key[2] = { trk->seed, 0U };
+  uint32_t ctr[4] = { 0U, 0U, 0U, 0U };
+  uint32_t rnd[4];
+  size_t i = 0U;
+
+  while (i < len)
+    {
+      const uint64_t blk = (uint64_t) (pos + i) / 4U;
+
+      ctr[0] = (uint32_t) blk;
+      ctr[1] = (uint32_t) (blk >> 32);
+      cd_philox (ctr, key, rnd);
+      for (size_t w = (pos + i) % 4U; (w < 4U) && (i < len); w++, i++)
+	{
+	  sam[i].s.l = (uint16_t) rnd[w];
+	  sam[i].s.r = (uint16_t) (rnd[w] >> 16);
+	}
+    }
+
+  return CD_OK;
+}
+
+static int
+stream_silence (const cd_track_t * trk, cd_sink_t * sink)
+{
+  int ret = CD_OK;
+  const size_t strip_size = trk->length / trk->strips * cd_frame_size;
+  sample_t sam[2];
+
+  for (size_t si = 0; (CD_OK == ret) && (si < trk->strips); si++)
+    {
+      sam[0].s.l = 0U;
+      sam[1].s.l = (si % 2U) ? ((uint16_t) (-1)) : 0U;
+      sam[0].s.r = sam[0].s.l;
+      sam[1].s.r = sam[1].s.l;
+
+      ret = cd_sink_repeat (sink, sam, 2U, strip_size / 2U);
+    }
+
+  return ret;
+}
+
+static size_t
+indexes_silence (const cd_track_t * trk, size_t * idx, size_t max)
+{
+  const size_t strip_size = trk->length / trk->strips * cd_frame_size;
+  size_t ret = 0U;
+
+  for (size_t si = 1; (si < trk->strips) && (ret < max); si++)
+    {
+      idx[ret++] = si * strip_size;
+    }
+
+  return ret;
+}
+
+static void
+describe_tone (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const double freq = (double) cd_fd / (double) trk->period;
+
+  snprintf (title, title_size, "Tone %8.3f Hz (0 dB)", freq);
+  snprintf (message, message_size, "FD (%d Hz) divided by %2d%s", cd_fd, (int) trk->period, filter_note (freq));
+}
+
+static void
+describe_square (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const double freq = (double) cd_fd / (double) trk->period;
+
+  snprintf (title, title_size, "Square pulses %3.0f Hz", freq);
+  snprintf (message, message_size, "FD (%d Hz) divided by %2d%s", cd_fd, (int) trk->period, filter_note (freq));
+}
+
+static void
+describe_pulse (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const double freq = (double) cd_fd / (double) trk->period;
+
+  snprintf (title, title_size, "Pop pulses %3.0f Hz", freq);
+  snprintf (message, message_size, "FD (%d Hz) divided by %2d%s", cd_fd, (int) trk->period, filter_note (freq));
+}
+
+static void
+describe_triangle (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const double freq = (double) cd_fd / (double) trk->period;
+
+  snprintf (title, title_size, "Triangle pulses %18.15f Hz", freq);
+  snprintf (message, message_size, "FD (%d Hz) divided by %2d%s", cd_fd, (int) trk->period, filter_note (freq));
+}
+
+static void
+describe_am_sine (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const double freq = (double) cd_fd / (double) trk->period;
+  const double freq_carr = freq * (double) trk->carrier;
+
+  snprintf (title, title_size, "Carrier %4.0f Hz AM modulated with %1.0f Hz sine", freq_carr, freq);
+  snprintf (message, message_size, "FD (%d Hz) divided by %2d%s", cd_fd, (int) trk->period, filter_note (freq));
+}
+
+static void
+describe_am_triangle (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const double freq = (double) cd_fd / (double) trk->period;
+  const double freq_carr = freq * (double) trk->carrier;
+
+  snprintf (title, title_size, "Carrier %4.0f Hz AM modulated with %1.0f Hz triangle", freq_carr, freq);
+  snprintf (message, message_size, "FD (%d Hz) divided by %2d%s", cd_fd, (int) trk->period, filter_note (freq));
+}
+
+static void
+describe_fm_step (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const size_t buf_num = (trk->steps - 1U) * 2U;
+  const double freq_envelope = (double) cd_fd / (double) trk->period / (double) buf_num;
+  size_t title_pos = 0U;
+  size_t r = 1U;
+
+  title_pos += snprintf (title, title_size, "Repeating frequencies ");
+  for (size_t ri = 0U; (trk->steps > ri) && (title_pos < title_size); ri++)
+    {
+      const double freq = (double) cd_fd / (double) trk->period * (double) r;
+      title_pos += snprintf (title + title_pos, title_size - title_pos, "%s%.3f", ri ? ", " : "", freq);
+      r *= trk->ratio;
+    }
+  if (title_pos < title_size)
+    {
+      snprintf (title + title_pos, title_size - title_pos, " Hz (0 dB) Envelope %5.3f Hz", freq_envelope);
+    }
+  snprintf (message, message_size, "FD (%d Hz) divided by %lu", cd_fd, trk->period * buf_num);
+}
+
+static void
+describe_noise (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  (void) trk;
+
+  snprintf (title, title_size, "White noise");
+  snprintf (message, message_size, "Random values");
+}
+
+static void
+describe_philox (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  snprintf (title, title_size, "White noise");
+  snprintf (message, message_size, "Random values, Philox4x32-10 seed 0x%08X", trk->seed);
+}
+
+static void
+remark_philox (const cd_track_t * trk, char *rem, size_t rem_size)
+{
+  snprintf (rem, rem_size, "NOISE philox4x32-10 SEED 0x%08X", trk->seed);
+}
+
+static void
+describe_silence (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size)
+{
+  const size_t strip_size = trk->length / trk->strips;
+  double strip_duration = ((double) strip_size * (double) cd_frame_size) / (double) cd_fd;
+
+  snprintf (title, title_size, "Silence");
+  snprintf (message, message_size, "Repeating %1.1f seconds constant zero level and %1.1f seconds clapping silence", strip_duration, strip_duration);
+}
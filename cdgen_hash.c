@@ -0,0 +1,1140 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Image checksums: CRC32 (the zlib one), MD5 and SHA-256, computed
+    together over the same bytes.  SHA-256 uses the SHA extensions where
+    the CPU has them, picked once at first use.
+
+    A hasher follows one image while it is written.  Sinks feed it every
+    run of bytes they produce, in any order from any thread, as a copy
+    of the run or a repeated pattern.  Threads of its own hash the runs
+    in image order, one per algorithm over the whole image and one per
+    algorithm over each range between the given bounds, MD5 alone being
+    slower than rendering.  Feeders wait while more than HASH_QUEUE
+    bytes are queued, except the one holding the next missing byte
+    while nothing else can be hashed.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CD_HASH_X86 1
+#include <immintrin.h>
+#endif
+
+#include "cdgen_int.h"
+
+enum
+{
+  HASH_CRC32 = 1,
+  HASH_MD5 = 2,
+  HASH_SHA256 = 4,
+  HASH_ALL = 7
+};
+
+#define HASH_ALGOS (3U)
+#define HASH_WORKERS (2U * HASH_ALGOS)	// Whole image and ranges
+
+typedef void (*sha_fn_t) (uint32_t * state, const uint8_t * data, size_t blocks);
+
+typedef struct
+{
+  const char *name;
+  int (*supported) (void);
+  sha_fn_t fn;
+} sha_kernel_t;
+
+/* Run of fed bytes, count copies of len bytes, all zero if zero is set */
+typedef struct hash_span
+{
+  struct hash_span *next;
+  size_t offset;
+  size_t len;
+  size_t count;
+  int zero;
+  unsigned int done;		// Workers through with it
+  uint8_t data[];
+} hash_span_t;
+
+/* Hash thread of one algorithm, one digest per range between consecutive bounds */
+typedef struct
+{
+  cd_hasher_t *hasher;
+  pthread_t thread;
+  int started;
+  unsigned int algo;
+  size_t pos;			// Image bytes hashed
+  const size_t *bounds;
+  size_t ranges_num;
+  size_t range;			// Current range
+  cd_hash_t hash;
+  cd_digest_t *digests;
+  uint8_t *expand;		// Short patterns repeated up to HASH_CHUNK bytes
+} hash_worker_t;
+
+struct cd_hasher
+{
+  pthread_mutex_t lock;
+  pthread_cond_t fed;		// New span or failure, wakes the workers
+  pthread_cond_t drained;	// Span hashed or failure, wakes feeders and cd_hasher_finish()
+  hash_span_t *spans;		// Ascending offsets
+  size_t queued;		// Bytes held by spans
+  size_t frontier;		// All bytes before are queued or hashed
+  size_t size;
+  int failed;
+  size_t image_bounds[2];
+  size_t *bounds;
+  cd_digest_t image;
+  cd_digest_t *ranges;
+  hash_worker_t workers[HASH_WORKERS];
+};
+
+#define HASH_QUEUE (64U << 20)	// Bytes
+#define HASH_CHUNK (65536U)	// Bytes hashed at once
+#define HASH_CHECK_LEN (8U << 20)	// Bytes timed per kernel
+
+static void crc_init (void);
+static uint32_t crc_update (uint32_t crc, const uint8_t * buf, size_t len);
+static uint32_t crc_mul (uint32_t a, uint32_t b);
+static uint32_t crc_shift (uint32_t crc, uint64_t len);
+static void md5_blocks (uint32_t * state, const uint8_t * data, size_t blocks);
+static void sha_blocks_scalar (uint32_t * state, const uint8_t * data, size_t blocks);
+static int sha_any (void);
+#ifdef CD_HASH_X86
+static void sha_blocks_shani (uint32_t * state, const uint8_t * data, size_t blocks);
+static int sha_has_shani (void);
+#endif
+static void hash_init (void);
+static void hash_with (cd_hash_t * hash, const uint8_t * buf, size_t len, unsigned int algos, sha_fn_t sha);
+static void hash_final_with (cd_hash_t * hash, cd_digest_t * digest, unsigned int algos, sha_fn_t sha);
+static size_t hasher_pos (const cd_hasher_t * hasher);
+static void worker_update (hash_worker_t * w, const uint8_t * buf, size_t len);
+static void worker_span (hash_worker_t * w, const hash_span_t * span);
+static void *hash_worker (void *arg);
+static void hasher_stop (cd_hasher_t * hasher);
+static int hash_check_known (void);
+static int hash_check_hasher (const uint8_t * buf, size_t len);
+
+// SHA-256 block kernels, best first, the first supported one is used
+static const sha_kernel_t sha_kernels[] = {
+#ifdef CD_HASH_X86
+  {"shani", sha_has_shani, sha_blocks_shani},
+#endif
+  {"scalar", sha_any, sha_blocks_scalar},
+};
+
+static const uint32_t sha_k[64] = {
+  0x428a2f98U, 0x71374491U, 0xb5c0fbcfU, 0xe9b5dba5U, 0x3956c25bU, 0x59f111f1U, 0x923f82a4U, 0xab1c5ed5U,
+  0xd807aa98U, 0x12835b01U, 0x243185beU, 0x550c7dc3U, 0x72be5d74U, 0x80deb1feU, 0x9bdc06a7U, 0xc19bf174U,
+  0xe49b69c1U, 0xefbe4786U, 0x0fc19dc6U, 0x240ca1ccU, 0x2de92c6fU, 0x4a7484aaU, 0x5cb0a9dcU, 0x76f988daU,
+  0x983e5152U, 0xa831c66dU, 0xb00327c8U, 0xbf597fc7U, 0xc6e00bf3U, 0xd5a79147U, 0x06ca6351U, 0x14292967U,
+  0x27b70a85U, 0x2e1b2138U, 0x4d2c6dfcU, 0x53380d13U, 0x650a7354U, 0x766a0abbU, 0x81c2c92eU, 0x92722c85U,
+  0xa2bfe8a1U, 0xa81a664bU, 0xc24b8b70U, 0xc76c51a3U, 0xd192e819U, 0xd6990624U, 0xf40e3585U, 0x106aa070U,
+  0x19a4c116U, 0x1e376c08U, 0x2748774cU, 0x34b0bcb5U, 0x391c0cb3U, 0x4ed8aa4aU, 0x5b9cca4fU, 0x682e6ff3U,
+  0x748f82eeU, 0x78a5636fU, 0x84c87814U, 0x8cc70208U, 0x90befffaU, 0xa4506cebU, 0xbef9a3f7U, 0xc67178f2U,
+};
+
+static pthread_once_t hash_once = PTHREAD_ONCE_INIT;
+static const sha_kernel_t *sha_sel;
+static uint32_t crc_table[8][256];
+static uint32_t crc_x2k[64];	// x^(2^k) mod the CRC polynomial, bit reflected
+static const uint8_t hash_zero[HASH_CHUNK];
+
+static void
+crc_init (void)
+{
+  for (uint32_t i = 0U; i < 256U; i++)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+	{
+	  c = (c >> 1) ^ ((c & 1U) ? 0xedb88320U : 0U);
+	}
+      crc_table[0][i] = c;
+    }
+  for (uint32_t i = 0U; i < 256U; i++)
+    {
+      for (int t = 1; t < 8; t++)
+	{
+	  crc_table[t][i] = (crc_table[t - 1][i] >> 8) ^ crc_table[0][crc_table[t - 1][i] & 0xffU];
+	}
+    }
+  crc_x2k[0] = 1U << 30;	// x
+  for (int k = 1; k < 64; k++)
+    {
+      crc_x2k[k] = crc_mul (crc_x2k[k - 1], crc_x2k[k - 1]);
+    }
+}
+
+/* a * b mod the CRC polynomial, bit reflected as the CRC register */
+static uint32_t
+crc_mul (uint32_t a, uint32_t b)
+{
+  uint32_t ret = 0U;
+
+  for (uint32_t m = 1U << 31; 0U != m; m >>= 1)
+    {
+      if (a & m)
+	{
+	  ret ^= b;
+	}
+      b = (b & 1U) ? ((b >> 1) ^ 0xedb88320U) : (b >> 1);
+    }
+
+  return ret;
+}
+
+/* CRC register after len more zero bytes */
+static uint32_t
+crc_shift (uint32_t crc, uint64_t len)
+{
+  len *= 8U;
+  for (int k = 0; 0U != len; k++, len >>= 1)
+    {
+      if (len & 1U)
+	{
+	  crc = crc_mul (crc_x2k[k], crc);
+	}
+    }
+
+  return crc;
+}
+
+/* CRC32 of buf following the bytes crc is the CRC32 of, 0 to start */
+uint32_t
+cd_crc32 (uint32_t crc, const uint8_t * buf, size_t len)
+{
+  pthread_once (&hash_once, hash_init);
+
+  return ~crc_update (~crc, buf, len);
+}
+
+/* CRC32 of a then b, from the CRC32 of each and the length of b */
+uint32_t
+cd_crc32_combine (uint32_t crc_a, uint32_t crc_b, uint64_t len_b)
+{
+  pthread_once (&hash_once, hash_init);
+
+  return crc_shift (crc_a, len_b) ^ crc_b;
+}
+
+/* CRC32 of count copies of len bytes with the given CRC32 */
+uint32_t
+cd_crc32_repeat (uint32_t crc, uint64_t len, uint64_t count)
+{
+  uint32_t ret = 0U;
+
+  for (; 0U != count; count >>= 1)
+    {
+      if (count & 1U)
+	{
+	  ret = cd_crc32_combine (ret, crc, len);
+	}
+      crc = cd_crc32_combine (crc, crc, len);
+      len *= 2U;
+    }
+
+  return ret;
+}
+
+/* CRC32 of len zero bytes */
+uint32_t
+cd_crc32_zeros (uint64_t len)
+{
+  pthread_once (&hash_once, hash_init);
+
+  return ~crc_shift (0xffffffffU, len);
+}
+
+/* Slicing by 8, crc is the running value, not inverted */
+static uint32_t
+crc_update (uint32_t crc, const uint8_t * buf, size_t len)
+{
+  size_t i = 0U;
+
+  for (; i + 8U <= len; i += 8U)
+    {
+      const uint32_t lo = crc ^ ((uint32_t) buf[i] | ((uint32_t) buf[i + 1U] << 8) | ((uint32_t) buf[i + 2U] << 16) | ((uint32_t) buf[i + 3U] << 24));
+      crc = crc_table[7][lo & 0xffU] ^ crc_table[6][(lo >> 8) & 0xffU] ^ crc_table[5][(lo >> 16) & 0xffU] ^ crc_table[4][lo >> 24]
+	^ crc_table[3][buf[i + 4U]] ^ crc_table[2][buf[i + 5U]] ^ crc_table[1][buf[i + 6U]] ^ crc_table[0][buf[i + 7U]];
+    }
+  for (; i < len; i++)
+    {
+      crc = (crc >> 8) ^ crc_table[0][(crc ^ buf[i]) & 0xffU];
+    }
+
+  return crc;
+}
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_STEP(f, a, b, c, d, x, t, s) \
+  do { (a) += f ((b), (c), (d)) + (x) + (t); (a) = ROTL ((a), (s)) + (b); } while (0)
+
+/* RFC 1321 */
+static void
+md5_blocks (uint32_t * state, const uint8_t * data, size_t blocks)
+{
+  for (; 0U < blocks; blocks--, data += 64)
+    {
+      uint32_t x[16];
+      uint32_t a = state[0];
+      uint32_t b = state[1];
+      uint32_t c = state[2];
+      uint32_t d = state[3];
+
+      for (int i = 0; i < 16; i++)
+	{
+	  x[i] = (uint32_t) data[4 * i] | ((uint32_t) data[4 * i + 1] << 8) | ((uint32_t) data[4 * i + 2] << 16) | ((uint32_t) data[4 * i + 3] << 24);
+	}
+
+      MD5_STEP (MD5_F, a, b, c, d, x[0], 0xd76aa478U, 7);
+      MD5_STEP (MD5_F, d, a, b, c, x[1], 0xe8c7b756U, 12);
+      MD5_STEP (MD5_F, c, d, a, b, x[2], 0x242070dbU, 17);
+      MD5_STEP (MD5_F, b, c, d, a, x[3], 0xc1bdceeeU, 22);
+      MD5_STEP (MD5_F, a, b, c, d, x[4], 0xf57c0fafU, 7);
+      MD5_STEP (MD5_F, d, a, b, c, x[5], 0x4787c62aU, 12);
+      MD5_STEP (MD5_F, c, d, a, b, x[6], 0xa8304613U, 17);
+      MD5_STEP (MD5_F, b, c, d, a, x[7], 0xfd469501U, 22);
+      MD5_STEP (MD5_F, a, b, c, d, x[8], 0x698098d8U, 7);
+      MD5_STEP (MD5_F, d, a, b, c, x[9], 0x8b44f7afU, 12);
+      MD5_STEP (MD5_F, c, d, a, b, x[10], 0xffff5bb1U, 17);
+      MD5_STEP (MD5_F, b, c, d, a, x[11], 0x895cd7beU, 22);
+      MD5_STEP (MD5_F, a, b, c, d, x[12], 0x6b901122U, 7);
+      MD5_STEP (MD5_F, d, a, b, c, x[13], 0xfd987193U, 12);
+      MD5_STEP (MD5_F, c, d, a, b, x[14], 0xa679438eU, 17);
+      MD5_STEP (MD5_F, b, c, d, a, x[15], 0x49b40821U, 22);
+
+      MD5_STEP (MD5_G, a, b, c, d, x[1], 0xf61e2562U, 5);
+      MD5_STEP (MD5_G, d, a, b, c, x[6], 0xc040b340U, 9);
+      MD5_STEP (MD5_G, c, d, a, b, x[11], 0x265e5a51U, 14);
+      MD5_STEP (MD5_G, b, c, d, a, x[0], 0xe9b6c7aaU, 20);
+      MD5_STEP (MD5_G, a, b, c, d, x[5], 0xd62f105dU, 5);
+      MD5_STEP (MD5_G, d, a, b, c, x[10], 0x02441453U, 9);
+      MD5_STEP (MD5_G, c, d, a, b, x[15], 0xd8a1e681U, 14);
+      MD5_STEP (MD5_G, b, c, d, a, x[4], 0xe7d3fbc8U, 20);
+      MD5_STEP (MD5_G, a, b, c, d, x[9], 0x21e1cde6U, 5);
+      MD5_STEP (MD5_G, d, a, b, c, x[14], 0xc33707d6U, 9);
+      MD5_STEP (MD5_G, c, d, a, b, x[3], 0xf4d50d87U, 14);
+      MD5_STEP (MD5_G, b, c, d, a, x[8], 0x455a14edU, 20);
+      MD5_STEP (MD5_G, a, b, c, d, x[13], 0xa9e3e905U, 5);
+      MD5_STEP (MD5_G, d, a, b, c, x[2], 0xfcefa3f8U, 9);
+      MD5_STEP (MD5_G, c, d, a, b, x[7], 0x676f02d9U, 14);
+      MD5_STEP (MD5_G, b, c, d, a, x[12], 0x8d2a4c8aU, 20);
+
+      MD5_STEP (MD5_H, a, b, c, d, x[5], 0xfffa3942U, 4);
+      MD5_STEP (MD5_H, d, a, b, c, x[8], 0x8771f681U, 11);
+      MD5_STEP (MD5_H, c, d, a, b, x[11], 0x6d9d6122U, 16);
+      MD5_STEP (MD5_H, b, c, d, a, x[14], 0xfde5380cU, 23);
+      MD5_STEP (MD5_H, a, b, c, d, x[1], 0xa4beea44U, 4);
+      MD5_STEP (MD5_H, d, a, b, c, x[4], 0x4bdecfa9U, 11);
+      MD5_STEP (MD5_H, c, d, a, b, x[7], 0xf6bb4b60U, 16);
+      MD5_STEP (MD5_H, b, c, d, a, x[10], 0xbebfbc70U, 23);
+      MD5_STEP (MD5_H, a, b, c, d, x[13], 0x289b7ec6U, 4);
+      MD5_STEP (MD5_H, d, a, b, c, x[0], 0xeaa127faU, 11);
+      MD5_STEP (MD5_H, c, d, a, b, x[3], 0xd4ef3085U, 16);
+      MD5_STEP (MD5_H, b, c, d, a, x[6], 0x04881d05U, 23);
+      MD5_STEP (MD5_H, a, b, c, d, x[9], 0xd9d4d039U, 4);
+      MD5_STEP (MD5_H, d, a, b, c, x[12], 0xe6db99e5U, 11);
+      MD5_STEP (MD5_H, c, d, a, b, x[15], 0x1fa27cf8U, 16);
+      MD5_STEP (MD5_H, b, c, d, a, x[2], 0xc4ac5665U, 23);
+
+      MD5_STEP (MD5_I, a, b, c, d, x[0], 0xf4292244U, 6);
+      MD5_STEP (MD5_I, d, a, b, c, x[7], 0x432aff97U, 10);
+      MD5_STEP (MD5_I, c, d, a, b, x[14], 0xab9423a7U, 15);
+      MD5_STEP (MD5_I, b, c, d, a, x[5], 0xfc93a039U, 21);
+      MD5_STEP (MD5_I, a, b, c, d, x[12], 0x655b59c3U, 6);
+      MD5_STEP (MD5_I, d, a, b, c, x[3], 0x8f0ccc92U, 10);
+      MD5_STEP (MD5_I, c, d, a, b, x[10], 0xffeff47dU, 15);
+      MD5_STEP (MD5_I, b, c, d, a, x[1], 0x85845dd1U, 21);
+      MD5_STEP (MD5_I, a, b, c, d, x[8], 0x6fa87e4fU, 6);
+      MD5_STEP (MD5_I, d, a, b, c, x[15], 0xfe2ce6e0U, 10);
+      MD5_STEP (MD5_I, c, d, a, b, x[6], 0xa3014314U, 15);
+      MD5_STEP (MD5_I, b, c, d, a, x[13], 0x4e0811a1U, 21);
+      MD5_STEP (MD5_I, a, b, c, d, x[4], 0xf7537e82U, 6);
+      MD5_STEP (MD5_I, d, a, b, c, x[11], 0xbd3af235U, 10);
+      MD5_STEP (MD5_I, c, d, a, b, x[2], 0x2ad7d2bbU, 15);
+      MD5_STEP (MD5_I, b, c, d, a, x[9], 0xeb86d391U, 21);
+
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+    }
+}
+
+/* FIPS 180-4 */
+static void
+sha_blocks_scalar (uint32_t * state, const uint8_t * data, size_t blocks)
+{
+  for (; 0U < blocks; blocks--, data += 64)
+    {
+      uint32_t w[64];
+      uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+      uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+      for (int i = 0; i < 16; i++)
+	{
+	  w[i] = ((uint32_t) data[4 * i] << 24) | ((uint32_t) data[4 * i + 1] << 16) | ((uint32_t) data[4 * i + 2] << 8) | (uint32_t) data[4 * i + 3];
+	}
+      for (int i = 16; i < 64; i++)
+	{
+	  const uint32_t s0 = ROTR (w[i - 15], 7) ^ ROTR (w[i - 15], 18) ^ (w[i - 15] >> 3);
+	  const uint32_t s1 = ROTR (w[i - 2], 17) ^ ROTR (w[i - 2], 19) ^ (w[i - 2] >> 10);
+	  w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+      for (int i = 0; i < 64; i++)
+	{
+	  const uint32_t t1 = h + (ROTR (e, 6) ^ ROTR (e, 11) ^ ROTR (e, 25)) + (g ^ (e & (f ^ g))) + sha_k[i] + w[i];
+	  const uint32_t t2 = (ROTR (a, 2) ^ ROTR (a, 13) ^ ROTR (a, 22)) + ((a & b) | (c & (a | b)));
+	  h = g;
+	  g = f;
+	  f = e;
+	  e = d + t1;
+	  d = c;
+	  c = b;
+	  b = a;
+	  a = t1 + t2;
+	}
+      state[0] += a;
+      state[1] += b;
+      state[2] += c;
+      state[3] += d;
+      state[4] += e;
+      state[5] += f;
+      state[6] += g;
+      state[7] += h;
+    }
+}
+
+static int
+sha_any (void)
+{
+  return 1;
+}
+
+#ifdef CD_HASH_X86
+/* Four rounds per step, the state kept as ABEF and CDGH as the instructions want it */
+__attribute__((target ("sha,sse4.1")))
+static void
+sha_blocks_shani (uint32_t * state, const uint8_t * data, size_t blocks)
+{
+  const __m128i bswap = _mm_set_epi64x (0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+  __m128i tmp = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) state), 0xb1);	// CDAB
+  __m128i st1 = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) (state + 4)), 0x1b);	// EFGH
+  __m128i st0 = _mm_alignr_epi8 (tmp, st1, 8);	// ABEF
+  st1 = _mm_blend_epi16 (st1, tmp, 0xf0);	// CDGH
+
+  for (; 0U < blocks; blocks--, data += 64)
+    {
+      const __m128i abef = st0;
+      const __m128i cdgh = st1;
+      __m128i msg[4];
+
+      for (int i = 0; i < 4; i++)
+	{
+	  msg[i] = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (data + 16 * i)), bswap);
+	}
+      for (int r = 0; r < 16; r++)
+	{
+	  const __m128i wk = _mm_add_epi32 (msg[r & 3], _mm_loadu_si128 ((const __m128i *) (sha_k + 4 * r)));
+
+	  st1 = _mm_sha256rnds2_epu32 (st1, st0, wk);
+	  st0 = _mm_sha256rnds2_epu32 (st0, st1, _mm_shuffle_epi32 (wk, 0x0e));
+	  if (r < 12)
+	    {
+	      // Words 4r + 16 onwards replace words 4r onwards
+	      const __m128i w = _mm_add_epi32 (_mm_sha256msg1_epu32 (msg[r & 3], msg[(r + 1) & 3]), _mm_alignr_epi8 (msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+	      msg[r & 3] = _mm_sha256msg2_epu32 (w, msg[(r + 3) & 3]);
+	    }
+	}
+      st0 = _mm_add_epi32 (st0, abef);
+      st1 = _mm_add_epi32 (st1, cdgh);
+    }
+
+  tmp = _mm_shuffle_epi32 (st0, 0x1b);	// FEBA
+  st1 = _mm_shuffle_epi32 (st1, 0xb1);	// DCHG
+  _mm_storeu_si128 ((__m128i *) state, _mm_blend_epi16 (tmp, st1, 0xf0));	// DCBA
+  _mm_storeu_si128 ((__m128i *) (state + 4), _mm_alignr_epi8 (st1, tmp, 8));	// HGFE
+}
+
+static int
+sha_has_shani (void)
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  __asm__ ("cpuid":"=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx):"a" (7), "c" (0));
+
+  return __builtin_cpu_supports ("sse4.1") && (0U != (ebx & (1U << 29)));
+}
+#endif
+
+static void
+hash_init (void)
+{
+  crc_init ();
+  for (size_t ki = 0U; (NULL == sha_sel) && (ki < sizeof (sha_kernels) / sizeof (sha_kernels[0])); ki++)
+    {
+      if (sha_kernels[ki].supported ())
+	{
+	  sha_sel = &sha_kernels[ki];
+	}
+    }
+}
+
+void
+cd_hash_init (cd_hash_t * hash)
+{
+  static const uint32_t md5_iv[4] = { 0x67452301U, 0xefcdab89U, 0x98badcfeU, 0x10325476U };
+  static const uint32_t sha_iv[8] = { 0x6a09e667U, 0xbb67ae85U, 0x3c6ef372U, 0xa54ff53aU, 0x510e527fU, 0x9b05688cU, 0x1f83d9abU, 0x5be0cd19U };
+
+  pthread_once (&hash_once, hash_init);
+  memset (hash, 0, sizeof (*hash));
+  hash->crc = 0xffffffffU;
+  memcpy (hash->md5, md5_iv, sizeof (md5_iv));
+  memcpy (hash->sha, sha_iv, sizeof (sha_iv));
+}
+
+/* Update the given algorithms, with the given SHA-256 kernel */
+static void
+hash_with (cd_hash_t * hash, const uint8_t * buf, size_t len, unsigned int algos, sha_fn_t sha)
+{
+  const size_t fill = (size_t) (hash->len % 64U);
+  const size_t md5 = (algos & HASH_MD5) ? 1U : 0U;
+  const size_t sha256 = (algos & HASH_SHA256) ? 1U : 0U;
+
+  if (algos & HASH_CRC32)
+    {
+      hash->crc = crc_update (hash->crc, buf, len);
+    }
+  hash->len += len;
+
+  if (fill && (fill + len < 64U))
+    {
+      memcpy (hash->blk + fill, buf, len);
+      len = 0U;
+    }
+  else if (fill)
+    {
+      memcpy (hash->blk + fill, buf, 64U - fill);
+      md5_blocks (hash->md5, hash->blk, md5);
+      sha (hash->sha, hash->blk, sha256);
+      buf += 64U - fill;
+      len -= 64U - fill;
+    }
+  if (64U <= len)
+    {
+      md5_blocks (hash->md5, buf, md5 * (len / 64U));
+      sha (hash->sha, buf, sha256 * (len / 64U));
+    }
+  memcpy (hash->blk, buf + len / 64U * 64U, len % 64U);
+}
+
+void
+cd_hash_update (cd_hash_t * hash, const uint8_t * buf, size_t len)
+{
+  hash_with (hash, buf, len, HASH_ALL, sha_sel->fn);
+}
+
+/* Fills in the digests of the given algorithms only */
+static void
+hash_final_with (cd_hash_t * hash, cd_digest_t * digest, unsigned int algos, sha_fn_t sha)
+{
+  const uint64_t bits = hash->len * 8U;
+  const size_t fill = (size_t) (hash->len % 64U);
+  uint8_t pad[128];
+  const size_t pad_len = (fill < 56U) ? 64U : 128U;
+
+  memset (pad, 0, sizeof (pad));
+  memcpy (pad, hash->blk, fill);
+  pad[fill] = 0x80U;
+  for (int i = 0; i < 8; i++)
+    {
+      pad[pad_len - 8U + (size_t) i] = (uint8_t) (bits >> (8 * i));	// MD5, little endian
+    }
+  md5_blocks (hash->md5, pad, (algos & HASH_MD5) ? (pad_len / 64U) : 0U);
+  for (int i = 0; i < 8; i++)
+    {
+      pad[pad_len - 1U - (size_t) i] = (uint8_t) (bits >> (8 * i));	// SHA-256, big endian
+    }
+  sha (hash->sha, pad, (algos & HASH_SHA256) ? (pad_len / 64U) : 0U);
+
+  if (algos & HASH_CRC32)
+    {
+      digest->crc32 = ~hash->crc;
+    }
+  for (int i = 0; (algos & HASH_MD5) && (i < 16); i++)
+    {
+      digest->md5[i] = (uint8_t) (hash->md5[i / 4] >> (8 * (i % 4)));
+    }
+  for (int i = 0; (algos & HASH_SHA256) && (i < 32); i++)
+    {
+      digest->sha256[i] = (uint8_t) (hash->sha[i / 4] >> (8 * (3 - i % 4)));
+    }
+}
+
+void
+cd_hash_final (cd_hash_t * hash, cd_digest_t * digest)
+{
+  hash_final_with (hash, digest, HASH_ALL, sha_sel->fn);
+}
+
+/* Lowest position still to hash, called locked */
+static size_t
+hasher_pos (const cd_hasher_t * hasher)
+{
+  size_t ret = hasher->size;
+
+  for (size_t wi = 0U; wi < HASH_WORKERS; wi++)
+    {
+      ret = (hasher->workers[wi].pos < ret) ? hasher->workers[wi].pos : ret;
+    }
+
+  return ret;
+}
+
+/* Hash len bytes at the worker position, closing each range it reaches the end of */
+static void
+worker_update (hash_worker_t * w, const uint8_t * buf, size_t len)
+{
+  while (0U < len)
+    {
+      size_t n = len;
+
+      if (w->range < w->ranges_num)
+	{
+	  const size_t begin = w->bounds[w->range];
+	  const size_t end = w->bounds[w->range + 1U];
+
+	  if (w->pos < begin)
+	    {
+	      n = (begin - w->pos < n) ? (begin - w->pos) : n;
+	    }
+	  else
+	    {
+	      n = (end - w->pos < n) ? (end - w->pos) : n;
+	      hash_with (&w->hash, buf, n, w->algo, sha_sel->fn);
+	    }
+	}
+      w->pos += n;
+      buf += n;
+      len -= n;
+
+      while ((w->range < w->ranges_num) && (w->pos == w->bounds[w->range + 1U]))
+	{
+	  hash_final_with (&w->hash, &w->digests[w->range], w->algo, sha_sel->fn);
+	  cd_hash_init (&w->hash);
+	  w->range++;
+	}
+    }
+}
+
+static void
+worker_span (hash_worker_t * w, const hash_span_t * span)
+{
+  if (span->zero || (HASH_CHUNK / 2U < span->len) || (NULL == w->expand))
+    {
+      const uint8_t *buf = span->zero ? hash_zero : span->data;
+      const size_t len = span->zero ? (span->len * span->count) : span->len;
+      const size_t count = span->zero ? 1U : span->count;
+
+      for (size_t ci = 0U; ci < count; ci++)
+	{
+	  for (size_t done = 0U; done < len; done += HASH_CHUNK)
+	    {
+	      worker_update (w, span->zero ? buf : (buf + done), (HASH_CHUNK < len - done) ? HASH_CHUNK : (len - done));
+	    }
+	}
+    }
+  else
+    {
+      // Short pattern, hash a chunk of whole copies at a time
+      const size_t per = HASH_CHUNK / span->len;
+
+      for (size_t ci = 0U; ci < per; ci++)
+	{
+	  memcpy (w->expand + ci * span->len, span->data, span->len);
+	}
+      for (size_t ci = 0U; ci < span->count; ci += per)
+	{
+	  worker_update (w, w->expand, ((per < span->count - ci) ? per : (span->count - ci)) * span->len);
+	}
+    }
+}
+
+static void *
+hash_worker (void *arg)
+{
+  hash_worker_t *w = arg;
+  cd_hasher_t *hasher = w->hasher;
+  const unsigned int bit = 1U << (w - hasher->workers);
+
+  pthread_mutex_lock (&hasher->lock);
+  while (!hasher->failed && (w->pos < hasher->size))
+    {
+      hash_span_t *span = hasher->spans;
+
+      while (span && (span->offset != w->pos))
+	{
+	  span = span->next;
+	}
+      if (NULL == span)
+	{
+	  pthread_cond_wait (&hasher->fed, &hasher->lock);
+	  continue;
+	}
+
+      pthread_mutex_unlock (&hasher->lock);
+      worker_span (w, span);
+      pthread_mutex_lock (&hasher->lock);
+
+      span->done |= bit;
+      if ((1U << HASH_WORKERS) - 1U == span->done)
+	{
+	  hash_span_t **prev = &hasher->spans;
+	  while (*prev != span)
+	    {
+	      prev = &(*prev)->next;
+	    }
+	  *prev = span->next;
+	  hasher->queued -= span->zero ? 0U : span->len;
+	  free (span);
+	}
+      pthread_cond_broadcast (&hasher->drained);
+    }
+  pthread_mutex_unlock (&hasher->lock);
+
+  return NULL;
+}
+
+/*
+    Hasher for an image of size bytes, digests of the whole image and of
+    the ranges_num ranges between bounds[0..ranges_num].
+*/
+cd_hasher_t *
+cd_hasher_new (size_t size, const size_t *bounds, size_t ranges_num)
+{
+  cd_hasher_t *ret = calloc (1U, sizeof (cd_hasher_t));
+
+  if (ret)
+    {
+      pthread_mutex_init (&ret->lock, NULL);
+      pthread_cond_init (&ret->fed, NULL);
+      pthread_cond_init (&ret->drained, NULL);
+      ret->size = size;
+      ret->image_bounds[1] = size;
+      ret->bounds = malloc ((ranges_num + 1U) * sizeof (size_t));
+      ret->ranges = calloc (ranges_num ? ranges_num : 1U, sizeof (cd_digest_t));
+    }
+
+  if (ret && ret->bounds && ret->ranges)
+    {
+      memcpy (ret->bounds, bounds, (ranges_num + 1U) * sizeof (size_t));
+      for (size_t wi = 0U; wi < HASH_WORKERS; wi++)
+	{
+	  hash_worker_t *w = &ret->workers[wi];
+	  const int whole = (wi < HASH_ALGOS);
+
+	  w->hasher = ret;
+	  w->algo = 1U << (wi % HASH_ALGOS);
+	  w->bounds = whole ? ret->image_bounds : ret->bounds;
+	  w->ranges_num = whole ? 1U : ranges_num;
+	  w->digests = whole ? &ret->image : ret->ranges;
+	  w->expand = malloc (HASH_CHUNK);
+	  cd_hash_init (&w->hash);
+	}
+      for (size_t wi = 0U; wi < HASH_WORKERS; wi++)
+	{
+	  const int cr_ret = pthread_create (&ret->workers[wi].thread, NULL, hash_worker, &ret->workers[wi]);
+	  if (0 != cr_ret)
+	    {
+	      fprintf (stderr, "Thread creation error: %s!\n\n", strerror (cr_ret));
+	      cd_hasher_free (ret);
+	      ret = NULL;
+	      break;
+	    }
+	  ret->workers[wi].started = 1;
+	}
+    }
+  else
+    {
+      fprintf (stderr, "Memory allocation error(hash): %s!\n\n", strerror (errno));
+      cd_hasher_free (ret);
+      ret = NULL;
+    }
+
+  return ret;
+}
+
+/*
+    Queue count copies of len bytes at buf, or zeros if buf is NULL, for
+    the image bytes from offset.  buf may be reused once this returns.
+*/
+int
+cd_hasher_feed (cd_hasher_t * hasher, size_t offset, const uint8_t * buf, size_t len, size_t count)
+{
+  int ret = CD_OK;
+  const size_t mem = buf ? len : 0U;
+  hash_span_t *span = NULL;
+
+  pthread_mutex_lock (&hasher->lock);
+  while (!hasher->failed && (HASH_QUEUE < hasher->queued + mem) && ((offset != hasher->frontier) || (hasher_pos (hasher) < hasher->frontier)))
+    {
+      pthread_cond_wait (&hasher->drained, &hasher->lock);
+    }
+  ret = hasher->failed ? CD_ERR_ARG : CD_OK;
+  pthread_mutex_unlock (&hasher->lock);
+
+  if ((CD_OK == ret) && (0U < len * count))
+    {
+      span = malloc (sizeof (hash_span_t) + mem);
+      if (NULL == span)
+	{
+	  fprintf (stderr, "Memory allocation error(hash): %s!\n\n", strerror (errno));
+	  cd_hasher_fail (hasher);
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  if (span)
+    {
+      span->offset = offset;
+      span->len = len;
+      span->count = count;
+      span->zero = (NULL == buf);
+      span->done = 0U;
+      if (buf)
+	{
+	  memcpy (span->data, buf, len);
+	}
+
+      pthread_mutex_lock (&hasher->lock);
+      hash_span_t **prev = &hasher->spans;
+      while (*prev && ((*prev)->offset < offset))
+	{
+	  prev = &(*prev)->next;
+	}
+      span->next = *prev;
+      *prev = span;
+      hasher->queued += mem;
+      for (hash_span_t * next = span; next && (next->offset == hasher->frontier); next = next->next)
+	{
+	  hasher->frontier += next->len * next->count;
+	}
+      pthread_cond_broadcast (&hasher->fed);
+      pthread_mutex_unlock (&hasher->lock);
+    }
+
+  return ret;
+}
+
+/* Give up, feeders and workers return at once */
+void
+cd_hasher_fail (cd_hasher_t * hasher)
+{
+  pthread_mutex_lock (&hasher->lock);
+  hasher->failed = 1;
+  pthread_cond_broadcast (&hasher->fed);
+  pthread_cond_broadcast (&hasher->drained);
+  pthread_mutex_unlock (&hasher->lock);
+}
+
+static void
+hasher_stop (cd_hasher_t * hasher)
+{
+  for (size_t wi = 0U; wi < HASH_WORKERS; wi++)
+    {
+      if (hasher->workers[wi].started)
+	{
+	  pthread_join (hasher->workers[wi].thread, NULL);
+	  hasher->workers[wi].started = 0;
+	}
+    }
+}
+
+/*
+    Wait until every byte is hashed and return the digests, of the
+    whole image and of each range.  CD_ERR_ARG if bytes are missing.
+*/
+int
+cd_hasher_finish (cd_hasher_t * hasher, cd_digest_t * image, cd_digest_t * ranges)
+{
+  int ret = CD_OK;
+
+  pthread_mutex_lock (&hasher->lock);
+  while (!hasher->failed && (hasher_pos (hasher) < hasher->size))
+    {
+      if (hasher->frontier < hasher->size)
+	{
+	  // Everything is fed by now, a gap will never be filled
+	  hasher->failed = 1;
+	  pthread_cond_broadcast (&hasher->fed);
+	  break;
+	}
+      pthread_cond_wait (&hasher->drained, &hasher->lock);
+    }
+  if (hasher->failed)
+    {
+      fprintf (stderr, "Hash incomplete, %lu of %lu bytes!\n\n", (unsigned long) hasher->frontier, (unsigned long) hasher->size);
+      ret = CD_ERR_ARG;
+    }
+  pthread_mutex_unlock (&hasher->lock);
+
+  hasher_stop (hasher);
+  if (CD_OK == ret)
+    {
+      *image = hasher->image;
+      memcpy (ranges, hasher->ranges, hasher->workers[HASH_WORKERS - 1U].ranges_num * sizeof (cd_digest_t));
+    }
+
+  return ret;
+}
+
+void
+cd_hasher_free (cd_hasher_t * hasher)
+{
+  if (hasher)
+    {
+      cd_hasher_fail (hasher);
+      hasher_stop (hasher);
+      while (hasher->spans)
+	{
+	  hash_span_t *next = hasher->spans->next;
+	  free (hasher->spans);
+	  hasher->spans = next;
+	}
+      for (size_t wi = 0U; wi < HASH_WORKERS; wi++)
+	{
+	  free (hasher->workers[wi].expand);
+	}
+      pthread_cond_destroy (&hasher->fed);
+      pthread_cond_destroy (&hasher->drained);
+      pthread_mutex_destroy (&hasher->lock);
+      free (hasher->ranges);
+      free (hasher->bounds);
+      free (hasher);
+    }
+}
+
+/* Known answers of all three, through every SHA-256 kernel */
+static int
+hash_check_known (void)
+{
+  int ret = CD_OK;
+  static const struct
+  {
+    const char *msg;
+    size_t repeat;
+    uint32_t crc32;
+    const char *md5;
+    const char *sha256;
+  } kat[] = {
+    {"", 1U, 0x00000000U, "d41d8cd98f00b204e9800998ecf8427e", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", 1U, 0x352441c2U, "900150983cd24fb0d6963f7d28e17f72", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"123456789", 1U, 0xcbf43926U, "25f9e794323b453885f5181f1b624d0b", "15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225"},
+    {"a", 1000000U, 0xdc25bfbcU, "7707d6ae4e027c70eea2a935c2296f21", "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+  };
+
+  for (size_t ki = 0U; ki < sizeof (sha_kernels) / sizeof (sha_kernels[0]); ki++)
+    {
+      for (size_t ai = 0U; sha_kernels[ki].supported () && (ai < sizeof (kat) / sizeof (kat[0])); ai++)
+	{
+	  cd_hash_t hash;
+	  cd_digest_t dig;
+	  char md5[33];
+	  char sha256[65];
+
+	  cd_hash_init (&hash);
+	  for (size_t ri = 0U; ri < kat[ai].repeat; ri++)
+	    {
+	      hash_with (&hash, (const uint8_t *) kat[ai].msg, strlen (kat[ai].msg), HASH_ALL, sha_kernels[ki].fn);
+	    }
+	  hash_final_with (&hash, &dig, HASH_ALL, sha_kernels[ki].fn);
+	  cd_digest_hex (dig.md5, sizeof (dig.md5), md5);
+	  cd_digest_hex (dig.sha256, sizeof (dig.sha256), sha256);
+	  if ((kat[ai].crc32 != dig.crc32) || (0 != strcmp (kat[ai].md5, md5)) || (0 != strcmp (kat[ai].sha256, sha256)))
+	    {
+	      fprintf (stderr, "hash %s: known answer %lu mismatch!\n\n", sha_kernels[ki].name, (unsigned long) ai);
+	      ret = CD_ERR_ARG;
+	    }
+	}
+    }
+
+  return ret;
+}
+
+/*
+    Feed an image of header, zero run, repeated pattern and data in
+    reverse order, with range bounds inside the runs, and compare the
+    digests with hashing the assembled image front to back.
+*/
+static int
+hash_check_hasher (const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+  const size_t pat_len = 2352U;
+  const size_t runs[][3] = {
+    // offset, bytes, copies; zero run at index 1
+    {0U, 44U, 1U},
+    {44U, 100000U, 1U},
+    {100044U, pat_len, 300U},
+    {100044U + 300U * pat_len, len / 2U, 1U},
+    {100044U + 300U * pat_len + len / 2U, len - len / 2U, 1U},
+    {100044U + 300U * pat_len + len, 7U, 1U},
+  };
+  const size_t size = 100051U + 300U * pat_len + len;
+  const size_t bounds[] = { 44U, 50044U, 100044U + 150U * pat_len + 3U, size - 7U, size };
+  const size_t ranges_num = sizeof (bounds) / sizeof (bounds[0]) - 1U;
+  uint8_t *img = malloc (size);
+  cd_hasher_t *hasher = cd_hasher_new (size, bounds, ranges_num);
+  cd_digest_t image;
+  cd_digest_t ranges[sizeof (bounds) / sizeof (bounds[0]) - 1U];
+
+  if ((NULL == img) || (NULL == hasher))
+    {
+      fprintf (stderr, "Memory allocation error(hash): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  for (size_t ri = sizeof (runs) / sizeof (runs[0]); (CD_OK == ret) && (0U < ri); ri--)
+    {
+      const size_t *run = runs[ri - 1U];
+      const uint8_t *src = (2U == ri) ? NULL : (buf + run[0] % 4096U);
+
+      for (size_t ci = 0U; ci < run[2]; ci++)
+	{
+	  if (src)
+	    {
+	      memcpy (img + run[0] + ci * run[1], src, run[1]);
+	    }
+	  else
+	    {
+	      memset (img + run[0] + ci * run[1], 0, run[1]);
+	    }
+	}
+      ret = cd_hasher_feed (hasher, run[0], src, run[1], run[2]);
+    }
+
+  if (CD_OK == ret)
+    {
+      ret = cd_hasher_finish (hasher, &image, ranges);
+    }
+  for (size_t ri = 0U; (CD_OK == ret) && (ri <= ranges_num); ri++)
+    {
+      cd_hash_t hash;
+      cd_digest_t dig;
+      const size_t begin = ri ? bounds[ri - 1U] : 0U;
+      const size_t end = ri ? bounds[ri] : size;
+
+      cd_hash_init (&hash);
+      cd_hash_update (&hash, img + begin, end - begin);
+      cd_hash_final (&hash, &dig);
+      if (0 != memcmp (&dig, ri ? &ranges[ri - 1U] : &image, sizeof (dig)))
+	{
+	  fprintf (stderr, "hasher: %s %lu mismatch!\n\n", ri ? "range" : "image", (unsigned long) ri);
+	  ret = CD_ERR_ARG;
+	}
+    }
+
+  cd_hasher_free (hasher);
+  free (img);
+
+  return ret;
+}
+
+/* Lower case hex of len bytes into hex, which holds 2 * len + 1 */
+void
+cd_digest_hex (const uint8_t * bytes, size_t len, char *hex)
+{
+  static const char digits[] = "0123456789abcdef";
+
+  for (size_t i = 0U; i < len; i++)
+    {
+      hex[2U * i] = digits[bytes[i] >> 4];
+      hex[2U * i + 1U] = digits[bytes[i] & 0x0fU];
+    }
+  hex[2U * len] = '\0';
+}
+
+/* Known answers, the hasher against a plain hash, and the speed of each part */
+int
+cd_hash_check (FILE * out)
+{
+  int ret = CD_OK;
+  uint8_t *buf = malloc (HASH_CHECK_LEN);
+
+  if (NULL == buf)
+    {
+      fprintf (stderr, "Memory allocation error(hash): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+  for (size_t i = 0U; (CD_OK == ret) && (i < HASH_CHECK_LEN); i++)
+    {
+      buf[i] = (uint8_t) ((i * 2654435761U) >> 13);
+    }
+
+  pthread_once (&hash_once, hash_init);
+  if (CD_OK == ret)
+    {
+      ret = hash_check_known ();
+    }
+  if (CD_OK == ret)
+    {
+      ret = hash_check_hasher (buf, 3U << 20);
+    }
+
+  if (CD_OK == ret)
+    {
+      uint32_t state[8] = { 0U };
+      double t0 = cd_clock ();
+      volatile uint32_t crc = crc_update (0U, buf, HASH_CHECK_LEN);
+      double t = cd_clock () - t0;
+
+      (void) crc;
+      fprintf (out, "hash %-13s: ok %8.0f MB/s\n", "crc32", (double) HASH_CHECK_LEN / 1e6 / (t > 0.0 ? t : 1e-9));
+      t0 = cd_clock ();
+      md5_blocks (state, buf, HASH_CHECK_LEN / 64U);
+      t = cd_clock () - t0;
+      fprintf (out, "hash %-13s: ok %8.0f MB/s\n", "md5", (double) HASH_CHECK_LEN / 1e6 / (t > 0.0 ? t : 1e-9));
+      for (size_t ki = 0U; ki < sizeof (sha_kernels) / sizeof (sha_kernels[0]); ki++)
+	{
+	  if (!sha_kernels[ki].supported ())
+	    {
+	      fprintf (out, "hash sha256 %-6s: not supported\n", sha_kernels[ki].name);
+	      continue;
+	    }
+	  t0 = cd_clock ();
+	  sha_kernels[ki].fn (state, buf, HASH_CHECK_LEN / 64U);
+	  t = cd_clock () - t0;
+	  fprintf (out, "hash sha256 %-6s: ok %8.0f MB/s%s\n", sha_kernels[ki].name, (double) HASH_CHECK_LEN / 1e6 / (t > 0.0 ? t : 1e-9),
+		   (sha_sel == &sha_kernels[ki]) ? " (used)" : "");
+	}
+    }
+
+  free (buf);
+
+  return ret;
+}
@@ -0,0 +1,1432 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Image writer backends.
+
+    stdio   fopen/fwrite, written front to back (default)
+    pwrite  preallocated file, positional writes from any thread
+    mmap    preallocated file mapped shared, sinks pack straight into it
+    clone   pwrite, repeated periods are replicated inside the file with
+	    FICLONERANGE (shared extents on XFS, btrfs) where the ranges
+	    are block aligned, copy_file_range otherwise
+    direct  O_DIRECT, front to back through two aligned buffers, one is
+	    filled while a helper thread writes the other; bypasses the
+	    page cache (or drops written pages where O_DIRECT is refused)
+    uring   io_uring, blocks are copied into registered buffers and up to
+	    queue_depth writes stay in flight; pwrite if io_uring is
+	    not available
+    stream  front to back to any file, FIFO or stdout ("-"); on a pipe
+	    repeated periods are handed over with vmsplice
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
+
+#include "cdgen_int.h"
+
+/* direct writer state */
+struct cd_image_direct
+{
+  uint8_t *buf[2];
+  int cur;			// Buffer being filled
+  size_t fill;			// Bytes in buf[cur]
+  int cached;			// O_DIRECT refused, write through the page cache
+  pthread_mutex_t lock;		// Guards busy, quit and ret
+  pthread_cond_t cond;		// busy or quit changed
+  pthread_t thread;		// Helper, writing buf[!cur] while busy
+  int started;			// Helper running, else blocks are written in place
+  int busy;
+  int quit;
+  size_t off;			// Job for thread: buf[!cur] to off
+  size_t len;
+  int ret;
+};
+
+#define DIRECT_ALIGN (4096U)
+
+/* uring writer state, the rings are set up with raw system calls */
+struct cd_image_uring
+{
+  int ring_fd;
+  pthread_mutex_t lock;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  unsigned int *sq_tail;
+  unsigned int *sq_mask;
+  unsigned int *sq_array;
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int *cq_mask;
+  struct io_uring_cqe *cqes;
+  int fixed;			// Buffers registered
+  size_t depth;
+  uint8_t *bufs;		// depth blocks of CD_SINK_BLOCK
+  size_t *slot_off;		// Image offset and length of each slot in flight
+  size_t *slot_len;
+  size_t *free_slots;
+  size_t free_num;
+  int ret;			// First failed completion
+};
+
+#define URING_DEPTH_DEFAULT (8U)
+
+#define STREAM_RUN (1U << 20)	// Bytes per repeated run, the largest pipe size by default
+
+static int hole_cmp (const void *a, const void *b);
+static int file_create (cd_image_t * img, const char *path, size_t size);
+static int file_reserve (cd_image_t * img, const char *path, size_t size);
+static int stdio_open (cd_image_t * img, const char *path, size_t size);
+static int stdio_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+static int stdio_close (cd_image_t * img);
+static int pwrite_open (cd_image_t * img, const char *path, size_t size);
+static int pwrite_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+static int pwrite_close (cd_image_t * img);
+static int update_open (cd_image_t * img, const char *path, size_t size);
+static int mmap_open (cd_image_t * img, const char *path, size_t size);
+static int mmap_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+static int mmap_close (cd_image_t * img);
+static int clone_open (cd_image_t * img, const char *path, size_t size);
+static int clone_copy (cd_image_t * img, size_t src, size_t dst, size_t len);
+static int clone_copy_range (cd_image_t * img, size_t src, size_t dst, size_t len);
+static int direct_open (cd_image_t * img, const char *path, size_t size);
+static int direct_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+static int direct_close (cd_image_t * img);
+static void *direct_worker (void *arg);
+static int direct_write (cd_image_t * img);
+static int direct_wait (cd_image_t * img);
+static int direct_submit (cd_image_t * img, size_t len);
+static int uring_open (cd_image_t * img, const char *path, size_t size);
+static int uring_setup (cd_image_t * img, size_t depth);
+static void uring_free (struct cd_image_uring *ring);
+static int uring_reap (cd_image_t * img, int wait);
+static int uring_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+static int uring_close (cd_image_t * img);
+static int stream_open (cd_image_t * img, const char *path, size_t size);
+static int stream_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+static int stream_out (cd_image_t * img, const uint8_t * buf, size_t len);
+static int stream_repeat (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len, size_t count);
+static int stream_close (cd_image_t * img);
+static int discard_open (cd_image_t * img, const char *path, size_t size);
+static int discard_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+static int discard_close (cd_image_t * img);
+static int discard_repeat (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len, size_t count);
+
+static const cd_image_ops_t image_ops[] = {
+  {"stdio", 0, 1, stdio_open, stdio_write_at, stdio_close, NULL, NULL},
+  {"pwrite", 1, 1, pwrite_open, pwrite_write_at, pwrite_close, NULL, NULL},
+  {"mmap", 1, 1, mmap_open, mmap_write_at, mmap_close, NULL, NULL},
+  {"clone", 1, 1, clone_open, pwrite_write_at, pwrite_close, clone_copy, NULL},
+  {"direct", 0, 0, direct_open, direct_write_at, direct_close, NULL, NULL},
+  {"uring", 1, 1, uring_open, uring_write_at, uring_close, NULL, NULL},
+  {"stream", 0, 0, stream_open, stream_write_at, stream_close, NULL, stream_repeat},
+};
+
+// Existing image rewritten in place, not selectable with -w
+static const cd_image_ops_t image_update_ops = { "update", 1, 0, update_open, pwrite_write_at, pwrite_close, NULL, NULL };
+
+// No file, for sinks only feeding the checksums, not selectable with -w
+static const cd_image_ops_t image_discard_ops = { "discard", 1, 0, discard_open, discard_write_at, discard_close, NULL, discard_repeat };
+
+const cd_image_ops_t *
+cd_image_find (const char *name)
+{
+  const cd_image_ops_t *ret = NULL;
+
+  for (size_t oi = 0U; (NULL == ret) && (oi < sizeof (image_ops) / sizeof (image_ops[0])); oi++)
+    {
+      if (0 == strcmp (name, image_ops[oi].name))
+	{
+	  ret = &image_ops[oi];
+	}
+    }
+
+  return ret;
+}
+
+int
+cd_image_open (cd_image_t * img, const cd_image_ops_t * ops, const char *path, size_t size, const cd_options_t * opt)
+{
+  memset (img, 0, sizeof (*img));
+  img->ops = ops;
+  img->size = size;
+  img->opt = opt;
+  img->fd = -1;
+  pthread_mutex_init (&img->holes_lock, NULL);
+  if (opt && opt->sparse)
+    {
+      img->sparse = ops->sparse;
+      if (!ops->sparse)
+	{
+	  fprintf (stderr, CD_WARN "writer %s cannot leave holes, writing zeros\n", ops->name);
+	}
+    }
+
+  return ops->open (img, path, size);
+}
+
+/*
+    Open an image of a previous build for positional writes, keeping its
+    contents.  It must already have the planned size.
+*/
+int
+cd_image_update (cd_image_t * img, const char *path, size_t size, const cd_options_t * opt)
+{
+  return cd_image_open (img, &image_update_ops, path, size, opt);
+}
+
+/* Image of size bytes that is never written, its runs only reach the checksums or verifier */
+int
+cd_image_discard (cd_image_t * img, size_t size)
+{
+  return cd_image_open (img, &image_discard_ops, NULL, size, NULL);
+}
+
+int
+cd_image_close (cd_image_t * img)
+{
+  int ret = CD_OK;
+
+  if (img->ops)
+    {
+      ret = img->ops->close (img);
+      img->ops = NULL;
+      pthread_mutex_destroy (&img->holes_lock);
+      free (img->holes);
+      img->holes = NULL;
+    }
+
+  return ret;
+}
+
+/*
+    Hand count copies of len bytes written at offset to the hasher, the
+    checksums and the verifier of img, buf NULL for zeros.
+*/
+int
+cd_image_feed (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len, size_t count)
+{
+  int ret = CD_OK;
+
+  if (img->hasher)
+    {
+      ret = cd_hasher_feed (img->hasher, offset, buf, len, count);
+    }
+  if ((CD_OK == ret) && img->accurip && (img->data_offset <= offset))
+    {
+      ret = cd_accurip_feed (img->accurip, offset - img->data_offset, buf, len, count);
+    }
+  if ((CD_OK == ret) && img->verify)
+    {
+      ret = cd_verify_feed (img->verify, offset, buf, len, count);
+    }
+
+  return ret;
+}
+
+/* Read back len bytes at offset of an image opened for update */
+int
+cd_image_read (cd_image_t * img, size_t offset, uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+
+  for (size_t done = 0U; (CD_OK == ret) && (done < len);)
+    {
+      const ssize_t rd = pread (img->fd, buf + done, len - done, (off_t) (offset + done));
+      if (0 < rd)
+	{
+	  done += (size_t) rd;
+	}
+      else
+	{
+	  fprintf (stderr, "Read error (data): %s!\n\n", (0 > rd) ? strerror (errno) : "short read");
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  return ret;
+}
+
+/* Record a zero run left unwritten, byte offset and length */
+int
+cd_image_hole (cd_image_t * img, size_t offset, size_t len)
+{
+  int ret = CD_OK;
+
+  pthread_mutex_lock (&img->holes_lock);
+  if (img->holes_num == img->holes_cap)
+    {
+      const size_t cap = img->holes_cap ? (img->holes_cap * 2U) : 64U;
+      cd_hole_t *holes = realloc (img->holes, cap * sizeof (cd_hole_t));
+      if (holes)
+	{
+	  img->holes = holes;
+	  img->holes_cap = cap;
+	}
+      else
+	{
+	  fprintf (stderr, "Memory allocation error(holes): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_MEM;
+	}
+    }
+  if (CD_OK == ret)
+    {
+      img->holes[img->holes_num].offset = offset;
+      img->holes[img->holes_num].len = len;
+      img->holes_num++;
+    }
+  pthread_mutex_unlock (&img->holes_lock);
+
+  return ret;
+}
+
+static int
+hole_cmp (const void *a, const void *b)
+{
+  const cd_hole_t *ha = a;
+  const cd_hole_t *hb = b;
+
+  return (ha->offset > hb->offset) - (ha->offset < hb->offset);
+}
+
+/*
+    Sort and merge the recorded holes and list them, one "offset length"
+    pair of bytes per line.  Call once all tracks are written.
+*/
+int
+cd_image_write_holes (cd_image_t * img, const char *path)
+{
+  int ret = CD_OK;
+  size_t merged = 0U;
+  size_t total = 0U;
+  FILE *out = fopen (path, "wt");
+
+  qsort (img->holes, img->holes_num, sizeof (cd_hole_t), hole_cmp);
+  for (size_t hi = 0U; hi < img->holes_num; hi++)
+    {
+      if ((0U < merged) && (img->holes[merged - 1U].offset + img->holes[merged - 1U].len == img->holes[hi].offset))
+	{
+	  img->holes[merged - 1U].len += img->holes[hi].len;
+	}
+      else
+	{
+	  img->holes[merged++] = img->holes[hi];
+	}
+      total += img->holes[hi].len;
+    }
+  img->holes_num = merged;
+
+  if (out)
+    {
+      fprintf (out, "# %s: %lu zero bytes in %lu holes, offset length\n", path, total, merged);
+      for (size_t hi = 0U; hi < merged; hi++)
+	{
+	  fprintf (out, "%lu %lu\n", img->holes[hi].offset, img->holes[hi].len);
+	}
+      if (0 != fclose (out))
+	{
+	  fprintf (stderr, "Write error (holes): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+    }
+  else
+    {
+      fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+
+  return ret;
+}
+
+static int
+stdio_open (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = CD_OK;
+
+  img->file = fopen (path, "wb");
+  if (NULL == img->file)
+    {
+      fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else if (img->sparse && (0 != ftruncate (fileno (img->file), (off_t) size)))
+    {
+      // Sized up front, a trailing hole is never written
+      fprintf (stderr, "Error sizing %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+
+  return ret;
+}
+
+static int
+stdio_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+
+  if ((offset != img->file_pos) && (0 != fseeko (img->file, (off_t) offset, SEEK_SET)))
+    {
+      fprintf (stderr, "Seek error (data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else if (1 != fwrite (buf, len, 1, img->file))
+    {
+      fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      img->file_pos = offset + len;
+    }
+
+  return ret;
+}
+
+static int
+stdio_close (cd_image_t * img)
+{
+  int ret = CD_OK;
+
+  if (img->file && (0 != fclose (img->file)))
+    {
+      fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  img->file = NULL;
+
+  return ret;
+}
+
+/* Create the image file read/write and reserve its whole size */
+static int
+file_create (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = CD_OK;
+
+  img->fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (0 > img->fd)
+    {
+      fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      ret = file_reserve (img, path, size);
+    }
+
+  return ret;
+}
+
+/*
+    Reserve the whole image so that tracks written out of order do not
+    fragment it, or only set its size when holes are wanted.
+*/
+static int
+file_reserve (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = CD_OK;
+  int fa_ret = img->sparse ? -1 : posix_fallocate (img->fd, 0, (off_t) size);
+
+  if ((0 != fa_ret) && (0 != ftruncate (img->fd, (off_t) size)))
+    {
+      fprintf (stderr, "Error sizing %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+
+  return ret;
+}
+
+static int
+pwrite_open (cd_image_t * img, const char *path, size_t size)
+{
+  return file_create (img, path, size);
+}
+
+static int
+update_open (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = CD_OK;
+  struct stat st;
+
+  img->fd = open (path, O_RDWR);
+  if ((0 > img->fd) || (0 != fstat (img->fd, &st)))
+    {
+      fprintf (stderr, CD_WARN "%s: %s\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else if ((off_t) size != st.st_size)
+    {
+      fprintf (stderr, CD_WARN "%s: %lu bytes, %lu planned\n", path, (unsigned long) st.st_size, (unsigned long) size);
+      ret = CD_ERR_FILE;
+    }
+
+  return ret;
+}
+
+static int
+pwrite_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+
+  while ((CD_OK == ret) && (0U < len))
+    {
+      ssize_t wr = pwrite (img->fd, buf, len, (off_t) offset);
+      if (0 < wr)
+	{
+	  buf += wr;
+	  offset += (size_t) wr;
+	  len -= (size_t) wr;
+	}
+      else if ((0 > wr) && (EINTR == errno))
+	{
+	  continue;
+	}
+      else
+	{
+	  fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  return ret;
+}
+
+static int
+pwrite_close (cd_image_t * img)
+{
+  int ret = CD_OK;
+
+  if ((0 <= img->fd) && (0 != close (img->fd)))
+    {
+      fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  img->fd = -1;
+
+  return ret;
+}
+
+static int
+mmap_open (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = file_create (img, path, size);
+
+  if (CD_OK == ret)
+    {
+      void *map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, img->fd, 0);
+      if (MAP_FAILED == map)
+	{
+	  fprintf (stderr, "Error mapping %s: %s!\n\n", path, strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+      else
+	{
+	  // Tracks are filled front to back, and each period is copied from just behind
+	  madvise (map, size, MADV_SEQUENTIAL);
+	  img->map = map;
+	}
+    }
+
+  return ret;
+}
+
+static int
+mmap_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+
+  if ((offset > img->size) || (len > img->size - offset))
+    {
+      fprintf (stderr, "Write error (data): %zu bytes at %zu beyond the image end!\n\n", len, offset);
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      memcpy (img->map + offset, buf, len);
+    }
+
+  return ret;
+}
+
+static int
+mmap_close (cd_image_t * img)
+{
+  int ret = CD_OK;
+
+  if (img->map && (0 != munmap (img->map, img->size)))
+    {
+      fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  img->map = NULL;
+
+  if ((0 <= img->fd) && (0 != close (img->fd)) && (CD_OK == ret))
+    {
+      fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  img->fd = -1;
+
+  return ret;
+}
+
+static int
+clone_open (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = pwrite_open (img, path, size);
+  struct stat st;
+
+  img->block = 4096U;
+  if ((CD_OK == ret) && (0 == fstat (img->fd, &st)) && (0 < st.st_blksize))
+    {
+      img->block = (size_t) st.st_blksize;
+    }
+
+  return ret;
+}
+
+/*
+    Clone the block aligned middle of the range when src and dst share
+    their alignment, the unaligned ends and everything else are copied.
+    Unsupported calls are remembered, so a file system without reflinks
+    only fails once.
+*/
+static int
+clone_copy (cd_image_t * img, size_t src, size_t dst, size_t len)
+{
+  int ret = CD_OK;
+  const size_t head = (img->block - (dst % img->block)) % img->block;
+
+  if (!img->no_clone && ((src % img->block) == (dst % img->block)) && (len >= head + img->block))
+    {
+      const size_t body = (len - head) / img->block * img->block;
+      struct file_clone_range fcr;
+
+      fcr.src_fd = img->fd;
+      fcr.src_offset = src + head;
+      fcr.src_length = body;
+      fcr.dest_offset = dst + head;
+      if (0 == ioctl (img->fd, FICLONERANGE, &fcr))
+	{
+	  ret = clone_copy_range (img, src, dst, head);
+	  if (CD_OK == ret)
+	    {
+	      ret = clone_copy_range (img, src + head + body, dst + head + body, len - head - body);
+	    }
+	  len = 0U;
+	}
+      else
+	{
+	  img->no_clone = 1;
+	}
+    }
+
+  if ((CD_OK == ret) && (0U < len))
+    {
+      ret = clone_copy_range (img, src, dst, len);
+    }
+
+  return ret;
+}
+
+static int
+clone_copy_range (cd_image_t * img, size_t src, size_t dst, size_t len)
+{
+  int ret = CD_OK;
+  uint8_t buf[65536];
+
+  while ((CD_OK == ret) && (0U < len) && !img->no_copy_range)
+    {
+      loff_t off_in = (loff_t) src;
+      loff_t off_out = (loff_t) dst;
+      ssize_t cp = copy_file_range (img->fd, &off_in, img->fd, &off_out, len, 0U);
+      if (0 < cp)
+	{
+	  src += (size_t) cp;
+	  dst += (size_t) cp;
+	  len -= (size_t) cp;
+	}
+      else if ((0 > cp) && (EINTR == errno))
+	{
+	  continue;
+	}
+      else
+	{
+	  img->no_copy_range = 1;
+	}
+    }
+
+  // Kernel copy not available, go through user space
+  while ((CD_OK == ret) && (0U < len))
+    {
+      const size_t chunk = (len < sizeof (buf)) ? len : sizeof (buf);
+      ssize_t rd = pread (img->fd, buf, chunk, (off_t) src);
+      if (0 < rd)
+	{
+	  ret = pwrite_write_at (img, dst, buf, (size_t) rd);
+	  src += (size_t) rd;
+	  dst += (size_t) rd;
+	  len -= (size_t) rd;
+	}
+      else if ((0 > rd) && (EINTR == errno))
+	{
+	  continue;
+	}
+      else
+	{
+	  fprintf (stderr, "Read error (data): %s!\n\n", (0 > rd) ? strerror (errno) : "short read");
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  return ret;
+}
+
+static int
+direct_open (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = CD_OK;
+  struct cd_image_direct *dio = calloc (1U, sizeof (struct cd_image_direct));
+
+  img->direct = dio;
+  if (dio)
+    {
+      pthread_mutex_init (&dio->lock, NULL);
+      pthread_cond_init (&dio->cond, NULL);
+    }
+  if ((NULL == dio) || (0 != posix_memalign ((void **) &dio->buf[0], DIRECT_ALIGN, CD_SINK_BLOCK)) || (0 != posix_memalign ((void **) &dio->buf[1], DIRECT_ALIGN, CD_SINK_BLOCK)))
+    {
+      fprintf (stderr, "Memory allocation error(direct): %s!\n\n", strerror (ENOMEM));
+      ret = CD_ERR_MEM;
+    }
+
+  if (CD_OK == ret)
+    {
+      img->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+      if ((0 > img->fd) && (EINVAL == errno))
+	{
+	  fprintf (stderr, CD_WARN "%s: O_DIRECT not supported, dropping written pages instead\n", path);
+	  dio->cached = 1;
+	  img->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	}
+      if (0 > img->fd)
+	{
+	  fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+      else
+	{
+	  ret = file_reserve (img, path, size);
+	}
+    }
+
+  // One helper for the whole image, without it every block is written in place
+  if ((CD_OK == ret) && (0 == pthread_create (&dio->thread, NULL, direct_worker, img)))
+    {
+      dio->started = 1;
+    }
+
+  return ret;
+}
+
+/* Write the submitted block, buf[!cur] */
+static int
+direct_write (cd_image_t * img)
+{
+  struct cd_image_direct *dio = img->direct;
+  int ret = pwrite_write_at (img, dio->off, dio->buf[!dio->cur], dio->len);
+
+  if ((CD_OK == ret) && dio->cached)
+    {
+      // Only clean pages can be dropped, wait for them to be written first
+      sync_file_range (img->fd, (off_t) dio->off, (off_t) dio->len, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+      posix_fadvise (img->fd, (off_t) dio->off, (off_t) dio->len, POSIX_FADV_DONTNEED);
+    }
+
+  return ret;
+}
+
+/* Helper, writes each submitted block until told to quit */
+static void *
+direct_worker (void *arg)
+{
+  cd_image_t *img = arg;
+  struct cd_image_direct *dio = img->direct;
+
+  pthread_mutex_lock (&dio->lock);
+  for (;;)
+    {
+      while (!dio->busy && !dio->quit)
+	{
+	  pthread_cond_wait (&dio->cond, &dio->lock);
+	}
+      if (!dio->busy)
+	{
+	  break;
+	}
+      pthread_mutex_unlock (&dio->lock);
+
+      const int ret = direct_write (img);
+
+      pthread_mutex_lock (&dio->lock);
+      dio->ret = ret;
+      dio->busy = 0;
+      pthread_cond_broadcast (&dio->cond);
+    }
+  pthread_mutex_unlock (&dio->lock);
+
+  return NULL;
+}
+
+/* Wait for the block in flight, returns its status */
+static int
+direct_wait (cd_image_t * img)
+{
+  struct cd_image_direct *dio = img->direct;
+  int ret = CD_OK;
+
+  pthread_mutex_lock (&dio->lock);
+  while (dio->busy)
+    {
+      pthread_cond_wait (&dio->cond, &dio->lock);
+    }
+  ret = dio->ret;
+  dio->ret = CD_OK;
+  pthread_mutex_unlock (&dio->lock);
+
+  return ret;
+}
+
+/* Hand the first len bytes of buf[cur] to the helper and switch buffers */
+static int
+direct_submit (cd_image_t * img, size_t len)
+{
+  struct cd_image_direct *dio = img->direct;
+  int ret = direct_wait (img);
+
+  if (CD_OK == ret)
+    {
+      dio->off = img->file_pos - dio->fill;
+      dio->len = len;
+      dio->cur = !dio->cur;
+      dio->fill = 0U;
+
+      if (dio->started)
+	{
+	  pthread_mutex_lock (&dio->lock);
+	  dio->busy = 1;
+	  pthread_cond_broadcast (&dio->cond);
+	  pthread_mutex_unlock (&dio->lock);
+	}
+      else
+	{
+	  ret = direct_write (img);
+	}
+    }
+
+  return ret;
+}
+
+static int
+direct_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+  struct cd_image_direct *dio = img->direct;
+
+  if (offset != img->file_pos)
+    {
+      fprintf (stderr, "Seek error (data): direct writer is sequential!\n\n");
+      ret = CD_ERR_FILE;
+    }
+
+  while ((CD_OK == ret) && (0U < len))
+    {
+      const size_t chunk = (CD_SINK_BLOCK - dio->fill < len) ? (CD_SINK_BLOCK - dio->fill) : len;
+
+      memcpy (dio->buf[dio->cur] + dio->fill, buf, chunk);
+      dio->fill += chunk;
+      img->file_pos += chunk;
+      buf += chunk;
+      len -= chunk;
+      if (CD_SINK_BLOCK == dio->fill)
+	{
+	  ret = direct_submit (img, CD_SINK_BLOCK);
+	}
+    }
+
+  return ret;
+}
+
+/*
+    The tail is padded with zeros up to the alignment, written, and the
+    file is cut back to the real size afterwards.
+*/
+static int
+direct_close (cd_image_t * img)
+{
+  int ret = CD_OK;
+  struct cd_image_direct *dio = img->direct;
+
+  if (dio && (0 <= img->fd))
+    {
+      const size_t tail = dio->fill;
+
+      if (0U < tail)
+	{
+	  const size_t padded = (tail + DIRECT_ALIGN - 1U) / DIRECT_ALIGN * DIRECT_ALIGN;
+	  memset (dio->buf[dio->cur] + tail, 0, padded - tail);
+	  ret = direct_submit (img, padded);
+	}
+
+      int wait_ret = direct_wait (img);
+      if (CD_OK == ret)
+	{
+	  ret = wait_ret;
+	}
+
+      if ((CD_OK == ret) && (0 != ftruncate (img->fd, (off_t) img->file_pos)))
+	{
+	  fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  if (dio && dio->started)
+    {
+      pthread_mutex_lock (&dio->lock);
+      dio->quit = 1;
+      pthread_cond_broadcast (&dio->cond);
+      pthread_mutex_unlock (&dio->lock);
+      pthread_join (dio->thread, NULL);
+      dio->started = 0;
+    }
+
+  int close_ret = pwrite_close (img);
+  if (CD_OK == ret)
+    {
+      ret = close_ret;
+    }
+
+  if (dio)
+    {
+      pthread_cond_destroy (&dio->cond);
+      pthread_mutex_destroy (&dio->lock);
+      free (dio->buf[0]);
+      free (dio->buf[1]);
+      free (dio);
+    }
+  img->direct = NULL;
+
+  return ret;
+}
+
+static int
+uring_open (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = file_create (img, path, size);
+  const size_t depth = (img->opt && img->opt->queue_depth) ? img->opt->queue_depth : URING_DEPTH_DEFAULT;
+
+  if ((CD_OK == ret) && (CD_OK != uring_setup (img, depth)))
+    {
+      fprintf (stderr, CD_WARN "%s: io_uring not available, using pwrite\n", path);
+    }
+
+  return ret;
+}
+
+static int
+uring_setup (cd_image_t * img, size_t depth)
+{
+  int ret = CD_OK;
+  struct io_uring_params par;
+  struct cd_image_uring *ring = calloc (1U, sizeof (struct cd_image_uring));
+
+  memset (&par, 0, sizeof (par));
+  if (ring)
+    {
+      ring->ring_fd = -1;
+      ring->depth = depth;
+      ring->slot_off = calloc (depth, sizeof (size_t));
+      ring->slot_len = calloc (depth, sizeof (size_t));
+      ring->free_slots = calloc (depth, sizeof (size_t));
+      if (0 != posix_memalign ((void **) &ring->bufs, 4096U, depth * CD_SINK_BLOCK))
+	{
+	  ring->bufs = NULL;
+	}
+      pthread_mutex_init (&ring->lock, NULL);
+    }
+  if ((NULL == ring) || (NULL == ring->slot_off) || (NULL == ring->slot_len) || (NULL == ring->free_slots) || (NULL == ring->bufs))
+    {
+      fprintf (stderr, "Memory allocation error(uring): %s!\n\n", strerror (ENOMEM));
+      ret = CD_ERR_MEM;
+    }
+
+  if (CD_OK == ret)
+    {
+      ring->ring_fd = (int) syscall (__NR_io_uring_setup, (unsigned int) depth, &par);
+      ret = (0 <= ring->ring_fd) ? CD_OK : CD_ERR_FILE;
+    }
+
+  if (CD_OK == ret)
+    {
+      ring->sq_ring_size = par.sq_off.array + par.sq_entries * sizeof (unsigned int);
+      ring->cq_ring_size = par.cq_off.cqes + par.cq_entries * sizeof (struct io_uring_cqe);
+      ring->sqes_size = par.sq_entries * sizeof (struct io_uring_sqe);
+      ring->sq_ring = mmap (NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+      ring->cq_ring = mmap (NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+      ring->sqes = mmap (NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+      if ((MAP_FAILED == ring->sq_ring) || (MAP_FAILED == ring->cq_ring) || (MAP_FAILED == ring->sqes))
+	{
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      uint8_t *sq = ring->sq_ring;
+      uint8_t *cq = ring->cq_ring;
+      struct iovec *iov = calloc (depth, sizeof (struct iovec));
+
+      ring->sq_tail = (unsigned int *) (sq + par.sq_off.tail);
+      ring->sq_mask = (unsigned int *) (sq + par.sq_off.ring_mask);
+      ring->sq_array = (unsigned int *) (sq + par.sq_off.array);
+      ring->cq_head = (unsigned int *) (cq + par.cq_off.head);
+      ring->cq_tail = (unsigned int *) (cq + par.cq_off.tail);
+      ring->cq_mask = (unsigned int *) (cq + par.cq_off.ring_mask);
+      ring->cqes = (struct io_uring_cqe *) (cq + par.cq_off.cqes);
+
+      for (size_t si = 0U; si < depth; si++)
+	{
+	  ring->free_slots[ring->free_num++] = si;
+	  if (iov)
+	    {
+	      iov[si].iov_base = ring->bufs + si * CD_SINK_BLOCK;
+	      iov[si].iov_len = CD_SINK_BLOCK;
+	    }
+	}
+
+      // Registering pins the buffers, plain writes still work where the memlock limit refuses that
+      ring->fixed = iov && (0 == syscall (__NR_io_uring_register, ring->ring_fd, IORING_REGISTER_BUFFERS, iov, (unsigned int) depth));
+      free (iov);
+    }
+
+  if (CD_OK == ret)
+    {
+      img->uring = ring;
+    }
+  else
+    {
+      uring_free (ring);
+    }
+
+  return ret;
+}
+
+static void
+uring_free (struct cd_image_uring *ring)
+{
+  if (ring)
+    {
+      if (ring->sq_ring && (MAP_FAILED != ring->sq_ring))
+	{
+	  munmap (ring->sq_ring, ring->sq_ring_size);
+	}
+      if (ring->cq_ring && (MAP_FAILED != ring->cq_ring))
+	{
+	  munmap (ring->cq_ring, ring->cq_ring_size);
+	}
+      if (ring->sqes && (MAP_FAILED != ring->sqes))
+	{
+	  munmap (ring->sqes, ring->sqes_size);
+	}
+      if (0 <= ring->ring_fd)
+	{
+	  close (ring->ring_fd);
+	}
+      pthread_mutex_destroy (&ring->lock);
+      free (ring->bufs);
+      free (ring->slot_off);
+      free (ring->slot_len);
+      free (ring->free_slots);
+      free (ring);
+    }
+}
+
+/*
+    Collect completions and return their slots, waiting for at least one
+    if wait is set.  Short writes are finished with pwrite.  Called locked.
+*/
+static int
+uring_reap (cd_image_t * img, int wait)
+{
+  int ret = CD_OK;
+  struct cd_image_uring *ring = img->uring;
+
+  if (wait && (0 > syscall (__NR_io_uring_enter, ring->ring_fd, 0U, 1U, IORING_ENTER_GETEVENTS, NULL, 0U)) && (EINTR != errno))
+    {
+      fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+
+  unsigned int head = *ring->cq_head;
+  const unsigned int tail = __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE);
+
+  while (head != tail)
+    {
+      const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+      const size_t slot = (size_t) cqe->user_data;
+
+      if (0 > cqe->res)
+	{
+	  fprintf (stderr, "Write error (data): %s!\n\n", strerror (-cqe->res));
+	  ring->ret = CD_ERR_FILE;
+	}
+      else if ((size_t) cqe->res < ring->slot_len[slot])
+	{
+	  const size_t done = (size_t) cqe->res;
+	  int wr_ret = pwrite_write_at (img, ring->slot_off[slot] + done, ring->bufs + slot * CD_SINK_BLOCK + done, ring->slot_len[slot] - done);
+	  if (CD_OK != wr_ret)
+	    {
+	      ring->ret = wr_ret;
+	    }
+	}
+      ring->free_slots[ring->free_num++] = slot;
+      head++;
+    }
+  __atomic_store_n (ring->cq_head, head, __ATOMIC_RELEASE);
+
+  if (CD_OK == ret)
+    {
+      ret = ring->ret;
+    }
+
+  return ret;
+}
+
+static int
+uring_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+  struct cd_image_uring *ring = img->uring;
+
+  if (NULL == ring)
+    {
+      ret = pwrite_write_at (img, offset, buf, len);
+      len = 0U;
+    }
+  else
+    {
+      pthread_mutex_lock (&ring->lock);
+    }
+
+  while ((CD_OK == ret) && (0U < len))
+    {
+      ret = uring_reap (img, 0U == ring->free_num);
+      if ((CD_OK != ret) || (0U == ring->free_num))
+	{
+	  continue;
+	}
+
+      const size_t slot = ring->free_slots[--ring->free_num];
+      const size_t chunk = (len < CD_SINK_BLOCK) ? len : CD_SINK_BLOCK;
+      uint8_t *slot_buf = ring->bufs + slot * CD_SINK_BLOCK;
+      const unsigned int tail = *ring->sq_tail;
+      const unsigned int idx = tail & *ring->sq_mask;
+      struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+      memcpy (slot_buf, buf, chunk);
+      ring->slot_off[slot] = offset;
+      ring->slot_len[slot] = chunk;
+
+      memset (sqe, 0, sizeof (*sqe));
+      sqe->opcode = ring->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+      sqe->fd = img->fd;
+      sqe->addr = (uint64_t) (uintptr_t) slot_buf;
+      sqe->len = (uint32_t) chunk;
+      sqe->off = offset;
+      sqe->buf_index = (uint16_t) slot;
+      sqe->user_data = slot;
+      ring->sq_array[idx] = idx;
+      __atomic_store_n (ring->sq_tail, tail + 1U, __ATOMIC_RELEASE);
+
+      if (1 != syscall (__NR_io_uring_enter, ring->ring_fd, 1U, 0U, 0U, NULL, 0U))
+	{
+	  fprintf (stderr, "Write error (data): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+      buf += chunk;
+      offset += chunk;
+      len -= chunk;
+    }
+
+  if (ring)
+    {
+      pthread_mutex_unlock (&ring->lock);
+    }
+
+  return ret;
+}
+
+static int
+uring_close (cd_image_t * img)
+{
+  int ret = CD_OK;
+  struct cd_image_uring *ring = img->uring;
+
+  if (ring)
+    {
+      int drained = 1;
+
+      // A slot buffer is freed only once its write completed, errors or not
+      pthread_mutex_lock (&ring->lock);
+      while (drained && (ring->free_num < ring->depth))
+	{
+	  const size_t free_num = ring->free_num;
+	  const int reap_ret = uring_reap (img, 1);
+
+	  if (CD_OK == ret)
+	    {
+	      ret = reap_ret;
+	    }
+	  // Waiting failed without a completion, the kernel may still read the buffers
+	  drained = (CD_OK == reap_ret) || (free_num != ring->free_num);
+	}
+      pthread_mutex_unlock (&ring->lock);
+      if (!drained)
+	{
+	  ring->bufs = NULL;
+	}
+      uring_free (ring);
+      img->uring = NULL;
+    }
+
+  int close_ret = pwrite_close (img);
+  if (CD_OK == ret)
+    {
+      ret = close_ret;
+    }
+
+  return ret;
+}
+
+static int
+stream_open (cd_image_t * img, const char *path, size_t size)
+{
+  int ret = CD_OK;
+  struct stat st;
+
+  (void) size;
+  if (0 == strcmp (path, "-"))
+    {
+      img->fd = STDOUT_FILENO;
+      img->fd_borrowed = 1;
+    }
+  else
+    {
+      img->fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+
+  if (0 > img->fd)
+    {
+      fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else if ((0 == fstat (img->fd, &st)) && S_ISFIFO (st.st_mode))
+    {
+      img->pipe = 1;
+      fcntl (img->fd, F_SETPIPE_SZ, (int) STREAM_RUN);
+    }
+
+  return ret;
+}
+
+/* Hand len bytes to the output, buf must stay unmodified once spliced */
+static int
+stream_out (cd_image_t * img, const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+
+  while ((CD_OK == ret) && (0U < len))
+    {
+      struct iovec iov = { (void *) buf, len };
+      ssize_t wr = img->pipe ? vmsplice (img->fd, &iov, 1U, 0U) : write (img->fd, buf, len);
+
+      if (0 < wr)
+	{
+	  buf += wr;
+	  len -= (size_t) wr;
+	  img->file_pos += (size_t) wr;
+	}
+      else if ((0 > wr) && (EINTR == errno))
+	{
+	  continue;
+	}
+      else if (img->pipe && (0 > wr) && ((EINVAL == errno) || (ENOSYS == errno)))
+	{
+	  img->pipe = 0;
+	}
+      else
+	{
+	  fprintf (stderr, "Write error (data): %s!\n\n", (0 > wr) ? strerror (errno) : "short write");
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  return ret;
+}
+
+static int
+stream_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len)
+{
+  int ret = CD_OK;
+
+  if (offset != img->file_pos)
+    {
+      fprintf (stderr, "Seek error (data): stream writer is sequential!\n\n");
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      // The caller reuses buf, so it is copied into the pipe rather than spliced
+      const int pipe = img->pipe;
+      img->pipe = 0;
+      ret = stream_out (img, buf, len);
+      img->pipe = pipe;
+    }
+
+  return ret;
+}
+
+/*
+    The run is built in its own anonymous mapping and never written again
+    after being spliced.  Unmapping it is safe, the pipe keeps the pages
+    until the reader has consumed them.
+*/
+static int
+stream_repeat (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len, size_t count)
+{
+  int ret = CD_OK;
+  const size_t per_run = (STREAM_RUN / len < count) ? ((STREAM_RUN / len) ? (STREAM_RUN / len) : 1U) : count;
+  uint8_t *run = MAP_FAILED;
+
+  if (offset != img->file_pos)
+    {
+      fprintf (stderr, "Seek error (data): stream writer is sequential!\n\n");
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      run = mmap (NULL, per_run * len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (MAP_FAILED == run)
+	{
+	  fprintf (stderr, "Memory allocation error(stream): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      size_t done = 1U;
+
+      memcpy (run, buf, len);
+      while (done < per_run)
+	{
+	  const size_t k = (done < per_run - done) ? done : (per_run - done);
+	  memcpy (run + done * len, run, k * len);
+	  done += k;
+	}
+    }
+
+  while ((CD_OK == ret) && (0U < count))
+    {
+      const size_t n = (per_run < count) ? per_run : count;
+      ret = stream_out (img, run, n * len);
+      count -= n;
+    }
+
+  if (MAP_FAILED != run)
+    {
+      munmap (run, per_run * len);
+    }
+
+  return ret;
+}
+
+static int
+stream_close (cd_image_t * img)
+{
+  int ret = CD_OK;
+
+  if (img->fd_borrowed)
+    {
+      img->fd = -1;
+    }
+  else
+    {
+      ret = pwrite_close (img);
+    }
+
+  return ret;
+}
+
+static int
+discard_open (cd_image_t * img, const char *path, size_t size)
+{
+  (void) img;
+  (void) path;
+  (void) size;
+  return CD_OK;
+}
+
+static int
+discard_write_at (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len)
+{
+  (void) buf;
+  return (offset + len <= img->size) ? CD_OK : CD_ERR_ARG;
+}
+
+static int
+discard_close (cd_image_t * img)
+{
+  (void) img;
+  return CD_OK;
+}
+
+/* Taken whole so that the sink does not expand repeated periods into blocks */
+static int
+discard_repeat (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len, size_t count)
+{
+  return discard_write_at (img, offset, buf, len * count);
+}
@@ -0,0 +1,297 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    libcdgen internals shared between the engine, the generators and
+    the output sinks.  Not installed, drivers only need cdgen.h.
+*/
+
+#ifndef CDGEN_INT_H
+#define CDGEN_INT_H
+
+#include <pthread.h>
+
+#include "cdgen.h"
+
+/*
+    Image writer backend.  Offsets and lengths are in bytes.  Writers
+    flagged positional accept write_at() from several threads at once at
+    any offset, the others expect one thread writing front to back.  A
+    writer setting map exposes the image memory, sinks write into it
+    directly instead of calling write_at().  Writers with copy() can
+    duplicate a range already written inside the image file, sinks then
+    write one period and replicate it.  Writers with repeat() take a run
+    of count copies of buf in one call.  Writers flagged sparse create the
+    file without allocating it, zero runs skipped with cd_image_hole()
+    stay holes.
+*/
+typedef struct cd_image cd_image_t;
+typedef struct cd_hasher cd_hasher_t;
+typedef struct cd_accurip cd_accurip_t;
+typedef struct cd_verify cd_verify_t;
+
+typedef struct
+{
+  size_t offset;
+  size_t len;
+} cd_hole_t;
+
+typedef struct
+{
+  const char *name;
+  int positional;
+  int sparse;
+  int (*open) (cd_image_t * img, const char *path, size_t size);
+  int (*write_at) (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len);
+  int (*close) (cd_image_t * img);
+  int (*copy) (cd_image_t * img, size_t src, size_t dst, size_t len);
+  int (*repeat) (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len, size_t count);
+} cd_image_ops_t;
+
+struct cd_image
+{
+  const cd_image_ops_t *ops;
+  size_t size;			// Planned image size
+  const cd_options_t *opt;
+  size_t data_offset;		// Container header bytes before the samples
+  cd_order_t order;		// Sample byte order
+  int sparse;			// Zero runs are skipped and recorded
+  pthread_mutex_t holes_lock;
+  cd_hole_t *holes;
+  size_t holes_num;
+  size_t holes_cap;
+  FILE *file;			// stdio
+  size_t file_pos;		// stdio
+  int fd;			// pwrite, mmap
+  uint8_t *map;			// mmap, whole image, zero filled when opened
+  size_t block;			// clone, file system block size
+  _Atomic int no_clone;		// clone, FICLONERANGE unsupported here, set by any job
+  _Atomic int no_copy_range;	// clone, copy_file_range unsupported here, set by any job
+  struct cd_image_direct *direct;	// direct, buffers and helper thread
+  struct cd_image_uring *uring;	// uring, NULL after falling back to pwrite
+  int fd_borrowed;		// stream, fd is stdout and stays open
+  int pipe;			// stream, fd is a pipe, runs go by vmsplice
+  cd_hasher_t *hasher;		// Fed every byte written when hashing, NULL if not
+  cd_accurip_t *accurip;	// Fed every sample written for checksums, NULL if not
+  cd_verify_t *verify;		// Compared with every byte written, NULL if not
+};
+
+const cd_image_ops_t *cd_image_find (const char *name);
+int cd_image_open (cd_image_t * img, const cd_image_ops_t * ops, const char *path, size_t size, const cd_options_t * opt);
+int cd_image_update (cd_image_t * img, const char *path, size_t size, const cd_options_t * opt);
+int cd_image_discard (cd_image_t * img, size_t size);
+int cd_image_close (cd_image_t * img);
+int cd_image_read (cd_image_t * img, size_t offset, uint8_t * buf, size_t len);
+int cd_image_hole (cd_image_t * img, size_t offset, size_t len);
+int cd_image_write_holes (cd_image_t * img, const char *path);
+int cd_image_feed (cd_image_t * img, size_t offset, const uint8_t * buf, size_t len, size_t count);
+
+/*
+    Image container: file name extension, how the TOC and CUE reference
+    it, sample byte order and the header in front of the samples.
+*/
+typedef struct
+{
+  const char *name;
+  const char *ext;
+  const char *ref_ext;
+  const char *cue_type;
+  cd_order_t order;
+  size_t header_size;
+  size_t (*header) (uint8_t * hdr, size_t data_size);
+} cd_format_t;
+
+const cd_format_t *cd_format_find (const char *name);
+const cd_format_t *cd_format_for (const char *name, size_t data_size);
+const cd_format_t *cd_format_of (const char *path, size_t data_size);
+int cd_format_header (const cd_format_t * fmt, cd_image_t * img, size_t data_size);
+
+/*
+    Samples to image bytes in the given order.  Host order is a copy, the
+    other one a byteswap, vectorized where the CPU allows.
+*/
+void cd_pack (cd_order_t order, uint8_t * buf, const sample_t * sam, size_t len);
+int cd_pack_check (FILE * out);
+
+/* sin and cos of x[0..n), either output may be NULL, vectorized where the CPU allows */
+void cd_sincos (const double *x, double *s, double *c, size_t n);
+const char *cd_sincos_kernel (size_t i);
+void cd_sincos_use (const char *name);
+int cd_sincos_check (FILE * out);
+
+/*
+    Output sink, the sequential cursor one track renders through, tee'd
+    to one image per format.  All positions and lengths are in samples.
+    Images in host byte order take the rendered samples as they are, the
+    others share one buffer byteswapped at most once per call.  Each
+    image collects its output in one block of CD_SINK_BLOCK bytes,
+    written when it fills up or the sink is closed; periods longer than
+    half a block bypass it.
+*/
+#define CD_SINK_BLOCK (7U * 602112U)	// 4 MB, multiple of 2352 and 4096
+
+typedef struct
+{
+  cd_image_t *img;
+  uint8_t *blk;			// Output block, page aligned
+  size_t blk_off;		// Image offset of blk, bytes
+  size_t blk_len;		// Bytes pending
+} cd_sink_out_t;
+
+typedef struct
+{
+  cd_sink_out_t out[CD_FORMAT_MAX];
+  size_t out_num;
+  size_t pos;
+  uint8_t *buf;			// Samples in the non host order
+  int buf_packed;		// buf holds the current samples
+  size_t buf_len;		// Capacity, samples
+} cd_sink_t;
+
+int cd_sink_open (cd_sink_t * sink, cd_image_t * img, size_t img_num, size_t pos);
+int cd_sink_close (cd_sink_t * sink);
+int cd_sink_write (cd_sink_t * sink, const sample_t * sam, size_t len);
+int cd_sink_repeat (cd_sink_t * sink, const sample_t * sam, size_t len, size_t count);
+int cd_sink_zero (cd_sink_t * sink, size_t len);
+
+/*
+    Waveform generator.  Periodic generators implement period() and
+    render() which fills exactly one period, the engine repeats it over
+    the track.  Aperiodic generators implement stream() instead and
+    write the whole track body themselves, or render_at() when any
+    range of the body can be computed on its own, which the engine then
+    renders in blocks on all threads.
+*/
+typedef struct
+{
+  const char *name;
+  size_t (*period) (const cd_track_t * trk);
+  int (*render) (const cd_track_t * trk, sample_t * sam, size_t len);
+  int (*stream) (const cd_track_t * trk, cd_sink_t * sink);
+  size_t (*indexes) (const cd_track_t * trk, size_t * idx, size_t max);
+  void (*describe) (const cd_track_t * trk, char *title, size_t title_size, char *message, size_t message_size);
+  int (*render_ref) (const cd_track_t * trk, sample_t * sam, size_t len);	// libm reference of render(), for checks
+  int (*render_at) (const cd_track_t * trk, size_t pos, sample_t * sam, size_t len);	// len samples from pos in the body
+  void (*remark) (const cd_track_t * trk, char *rem, size_t rem_size);	// Extra CUE REM, NULL for none
+} cd_gen_t;
+
+/* Worker threads, shared by every disc an engine renders */
+typedef struct cd_pool cd_pool_t;
+
+cd_pool_t *cd_pool_new (size_t threads);
+void cd_pool_free (cd_pool_t * pool);
+int cd_pool_run (cd_pool_t * pool, int (*fn) (void *arg, size_t i), void *arg, size_t num);
+
+void *cd_arena_alloc (cd_arena_t * arena, size_t size);
+char *cd_arena_strdup (cd_arena_t * arena, const char *str);
+void cd_arena_free (cd_arena_t * arena);
+
+char *cd_make_name (const char *base_name, const char *ext);
+double cd_clock (void);
+
+const cd_gen_t *cd_gen_get (cd_gen_type_t type);
+int cd_gen_find (const char *name, cd_gen_type_t * type);
+int cd_gen_check (const cd_track_t * trk, FILE * out);
+
+// Bump whenever a generator renders differently, invalidates cached periods and builds
+#define CD_RENDER_VERSION (1)
+
+int cd_cache_open (const char *dir);
+int cd_cache_load (const char *dir, const cd_track_t * trk, size_t len, sample_t ** sam, void **map, size_t *map_len);
+int cd_cache_store (const char *dir, const cd_track_t * trk, const sample_t * sam, size_t len);
+
+void cd_philox (const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+
+/* glibc random() sequence after srandom(), at any draw */
+#define CD_GLIBC_HIST (37)	// Sequence values kept, 31 needed, the rest pad lanes to whole rows
+#define CD_GLIBC_LANES (8U)
+
+typedef struct
+{
+  uint32_t hist[CD_GLIBC_HIST];	// Sequence values before the next draw
+} cd_glibc_t;
+
+void cd_glibc_seek (cd_glibc_t * rnd, unsigned int seed, uint64_t draw);
+void cd_glibc_draw (cd_glibc_t * rnd, int32_t * out, size_t n);
+void cd_glibc_fill (unsigned int seed, uint64_t draw, int32_t * out, size_t n);
+int cd_rng_check (FILE * out);
+
+/* CRC32, MD5 and SHA-256 at once */
+typedef struct
+{
+  uint32_t crc32;
+  uint8_t md5[16];
+  uint8_t sha256[32];
+} cd_digest_t;
+
+typedef struct
+{
+  uint64_t len;
+  uint32_t crc;
+  uint32_t md5[4];
+  uint32_t sha[8];
+  uint8_t blk[64];		// Partial block
+} cd_hash_t;
+
+uint32_t cd_crc32 (uint32_t crc, const uint8_t * buf, size_t len);
+uint32_t cd_crc32_combine (uint32_t crc_a, uint32_t crc_b, uint64_t len_b);
+uint32_t cd_crc32_repeat (uint32_t crc, uint64_t len, uint64_t count);
+uint32_t cd_crc32_zeros (uint64_t len);
+void cd_hash_init (cd_hash_t * hash);
+void cd_hash_update (cd_hash_t * hash, const uint8_t * buf, size_t len);
+void cd_hash_final (cd_hash_t * hash, cd_digest_t * digest);
+void cd_digest_hex (const uint8_t * bytes, size_t len, char *hex);
+int cd_hash_check (FILE * out);
+
+/* Red Book limits of the layout planner, see cdgen_plan.c */
+int cd_plan_check (FILE * out);
+
+/* Digests of an image, fed while it is written, see cdgen_hash.c */
+cd_hasher_t *cd_hasher_new (size_t size, const size_t *bounds, size_t ranges_num);
+int cd_hasher_feed (cd_hasher_t * hasher, size_t offset, const uint8_t * buf, size_t len, size_t count);
+void cd_hasher_fail (cd_hasher_t * hasher);
+int cd_hasher_finish (cd_hasher_t * hasher, cd_digest_t * image, cd_digest_t * ranges);
+void cd_hasher_free (cd_hasher_t * hasher);
+
+/* AccurateRip and CUETools checksums per track, see cdgen_accurip.c */
+cd_accurip_t *cd_accurip_new (const cd_plan_t * plan);
+int cd_accurip_feed (cd_accurip_t * acc, size_t offset, const uint8_t * buf, size_t len, size_t count);
+int cd_accurip_store (cd_accurip_t * acc, const char *path, const cd_plan_t * plan);
+void cd_accurip_free (cd_accurip_t * acc);
+int cd_accurip_check (FILE * out);
+
+/* Existing image compared with the render, see cdgen_verify.c */
+cd_verify_t *cd_verify_open (const char *path, const cd_plan_t * plan, size_t size, size_t data_offset);
+int cd_verify_feed (cd_verify_t * v, size_t offset, const uint8_t * buf, size_t len, size_t count);
+int cd_verify_report (const cd_verify_t * v, FILE * out);
+void cd_verify_free (cd_verify_t * v);
+int cd_verify_check (FILE * out);
+
+int cd_build_changed (const char *path, const cd_plan_t * plan, const cd_options_t * opt, uint8_t * changed);
+int cd_build_store (const char *path, const cd_plan_t * plan, const cd_options_t * opt);
+
+/* One image in the manifest, digests of the whole image then of each track */
+typedef struct
+{
+  const char *name;
+  const char *format;
+  size_t size;
+  size_t data_offset;
+  const cd_digest_t *digests;
+} cd_manifest_image_t;
+
+int cd_manifest_store (const char *path, const cd_plan_t * plan, const cd_manifest_image_t * images, size_t images_num);
+
+#endif /* CDGEN_INT_H */
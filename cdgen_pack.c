@@ -0,0 +1,315 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Byte order conversion of rendered samples into image bytes.  Which
+    target order is a copy and which a byteswap is fixed at build time
+    from the host order.  The byteswap uses the widest of SSE2, SSSE3
+    or AVX2 the CPU has on x86, picked once at first use, a portable
+    loop elsewhere.  cd_pack_check() runs every kernel the CPU supports
+    against a reference computed from the sample values.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CD_PACK_X86 1
+#include <immintrin.h>
+#endif
+
+#include "cdgen_int.h"
+
+typedef void (*pack_fn_t) (uint8_t * buf, const sample_t * sam, size_t len);
+
+typedef struct
+{
+  const char *name;
+  int (*supported) (void);
+  pack_fn_t fn;
+} pack_kernel_t;
+
+static void pack_ref (cd_order_t order, uint8_t * buf, const sample_t * sam, size_t len);
+static void pack_copy (uint8_t * buf, const sample_t * sam, size_t len);
+static void pack_swap (uint8_t * buf, const sample_t * sam, size_t len);
+static void pack_swap_scalar (uint8_t * buf, const sample_t * sam, size_t len);
+static int pack_any (void);
+#ifdef CD_PACK_X86
+static void pack_swap_sse2 (uint8_t * buf, const sample_t * sam, size_t len);
+static void pack_swap_ssse3 (uint8_t * buf, const sample_t * sam, size_t len);
+static void pack_swap_avx2 (uint8_t * buf, const sample_t * sam, size_t len);
+static int pack_has_ssse3 (void);
+static int pack_has_avx2 (void);
+#endif
+static void pack_init (void);
+
+// Byteswap kernels, best first, the first supported one is used
+static const pack_kernel_t pack_kernels[] = {
+#ifdef CD_PACK_X86
+  {"avx2", pack_has_avx2, pack_swap_avx2},
+  {"ssse3", pack_has_ssse3, pack_swap_ssse3},
+  {"sse2", pack_any, pack_swap_sse2},
+#endif
+  {"scalar", pack_any, pack_swap_scalar},
+};
+
+// Converter per target order, fixed at build time by the host order
+static const pack_fn_t pack_order[2] = {
+#if CD_HOST_BE
+  [CD_ORDER_BE] = pack_copy,
+  [CD_ORDER_LE] = pack_swap,
+#else
+  [CD_ORDER_BE] = pack_swap,
+  [CD_ORDER_LE] = pack_copy,
+#endif
+};
+
+#define PACK_CHECK_REPS (32)	// Timed passes per kernel
+
+static pthread_once_t pack_once = PTHREAD_ONCE_INIT;
+static const pack_kernel_t *pack_sel;
+
+/* Reference, from the sample values, independent of the host */
+static void
+pack_ref (cd_order_t order, uint8_t * buf, const sample_t * sam, size_t len)
+{
+  size_t buf_pos = 0U;
+
+  for (size_t i = 0; i < len; i++)
+    {
+      const uint16_t ch[2] = { sam[i].s.l, sam[i].s.r };
+      for (int ci = 0; ci < 2; ci++)
+	{
+	  buf[buf_pos++] = (uint8_t) ((CD_ORDER_BE == order) ? (ch[ci] >> 8) : ch[ci]);
+	  buf[buf_pos++] = (uint8_t) ((CD_ORDER_BE == order) ? ch[ci] : (ch[ci] >> 8));
+	}
+    }
+}
+
+/* Host order, nothing to do when packing in place */
+static void
+pack_copy (uint8_t * buf, const sample_t * sam, size_t len)
+{
+  if ((const void *) buf != (const void *) sam)
+    {
+      memcpy (buf, sam, len * cd_sample_size);
+    }
+}
+
+static void
+pack_swap (uint8_t * buf, const sample_t * sam, size_t len)
+{
+  pthread_once (&pack_once, pack_init);
+  pack_sel->fn (buf, sam, len);
+}
+
+static void
+pack_swap_scalar (uint8_t * buf, const sample_t * sam, size_t len)
+{
+  const uint8_t *src = (const uint8_t *) sam;
+
+  for (size_t i = 0; i < len * cd_sample_size; i += 2U)
+    {
+      const uint8_t lo = src[i];
+      buf[i] = src[i + 1U];
+      buf[i + 1U] = lo;
+    }
+}
+
+static int
+pack_any (void)
+{
+  return 1;
+}
+
+#ifdef CD_PACK_X86
+__attribute__((target ("sse2")))
+static void
+pack_swap_sse2 (uint8_t * buf, const sample_t * sam, size_t len)
+{
+  const uint8_t *src = (const uint8_t *) sam;
+  const size_t bytes = len * cd_sample_size;
+  size_t i = 0U;
+
+  for (; i + 16U <= bytes; i += 16U)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+      v = _mm_or_si128 (_mm_slli_epi16 (v, 8), _mm_srli_epi16 (v, 8));
+      _mm_storeu_si128 ((__m128i *) (buf + i), v);
+    }
+  pack_swap_scalar (buf + i, sam + i / cd_sample_size, len - i / cd_sample_size);
+}
+
+__attribute__((target ("ssse3")))
+static void
+pack_swap_ssse3 (uint8_t * buf, const sample_t * sam, size_t len)
+{
+  const uint8_t *src = (const uint8_t *) sam;
+  const size_t bytes = len * cd_sample_size;
+  const __m128i swap = _mm_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  size_t i = 0U;
+
+  for (; i + 16U <= bytes; i += 16U)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+      _mm_storeu_si128 ((__m128i *) (buf + i), _mm_shuffle_epi8 (v, swap));
+    }
+  pack_swap_scalar (buf + i, sam + i / cd_sample_size, len - i / cd_sample_size);
+}
+
+__attribute__((target ("avx2")))
+static void
+pack_swap_avx2 (uint8_t * buf, const sample_t * sam, size_t len)
+{
+  const uint8_t *src = (const uint8_t *) sam;
+  const size_t bytes = len * cd_sample_size;
+  const __m256i swap = _mm256_setr_epi8 (1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+					 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  size_t i = 0U;
+
+  for (; i + 64U <= bytes; i += 64U)
+    {
+      __m256i v0 = _mm256_loadu_si256 ((const __m256i *) (src + i));
+      __m256i v1 = _mm256_loadu_si256 ((const __m256i *) (src + i + 32U));
+      _mm256_storeu_si256 ((__m256i *) (buf + i), _mm256_shuffle_epi8 (v0, swap));
+      _mm256_storeu_si256 ((__m256i *) (buf + i + 32U), _mm256_shuffle_epi8 (v1, swap));
+    }
+  for (; i + 32U <= bytes; i += 32U)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (src + i));
+      _mm256_storeu_si256 ((__m256i *) (buf + i), _mm256_shuffle_epi8 (v, swap));
+    }
+  pack_swap_scalar (buf + i, sam + i / cd_sample_size, len - i / cd_sample_size);
+}
+
+static int
+pack_has_ssse3 (void)
+{
+  return __builtin_cpu_supports ("ssse3");
+}
+
+static int
+pack_has_avx2 (void)
+{
+  return __builtin_cpu_supports ("avx2");
+}
+#endif
+
+static void
+pack_init (void)
+{
+  for (size_t ki = 0U; (NULL == pack_sel) && (ki < sizeof (pack_kernels) / sizeof (pack_kernels[0])); ki++)
+    {
+      if (pack_kernels[ki].supported ())
+	{
+	  pack_sel = &pack_kernels[ki];
+	}
+    }
+}
+
+void
+cd_pack (cd_order_t order, uint8_t * buf, const sample_t * sam, size_t len)
+{
+  pack_order[order] (buf, sam, len);
+}
+
+/*
+    Compare the converter of each target order and every supported
+    byteswap kernel with the reference over odd lengths and misaligned
+    buffers, then time each on one large buffer.
+*/
+int
+cd_pack_check (FILE * out)
+{
+  int ret = CD_OK;
+  const size_t len = 1U << 20;
+  const size_t kernels_num = sizeof (pack_kernels) / sizeof (pack_kernels[0]);
+  sample_t *sam = malloc ((len + 1U) * sizeof (sample_t));
+  uint8_t *ref = malloc ((len + 1U) * cd_sample_size);
+  uint8_t *buf = malloc ((len + 1U) * cd_sample_size + 1U);
+
+  if ((NULL == sam) || (NULL == ref) || (NULL == buf))
+    {
+      fprintf (stderr, "Memory allocation error(pack): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  for (size_t i = 0U; (CD_OK == ret) && (i <= len); i++)
+    {
+      sam[i].s.l = (uint16_t) (i * 40503U);
+      sam[i].s.r = (uint16_t) ~(i * 2654435761U >> 7);
+    }
+
+  pthread_once (&pack_once, pack_init);
+  for (size_t ki = 0U; (CD_OK == ret) && (ki < kernels_num + 2U); ki++)
+    {
+      // The two order converters first, then the byteswap kernels
+      const cd_order_t order = (ki < 2U) ? (cd_order_t) ki : (cd_order_t) !CD_HOST_ORDER;
+      const pack_fn_t fn = (ki < 2U) ? pack_order[order] : pack_kernels[ki - 2U].fn;
+      const char *name = (ki < 2U) ? ((CD_HOST_ORDER == order) ? "copy" : pack_sel->name) : pack_kernels[ki - 2U].name;
+
+      if ((2U <= ki) && !pack_kernels[ki - 2U].supported ())
+	{
+	  fprintf (out, "pack %-6s: not supported\n", name);
+	  continue;
+	}
+
+      for (size_t n = 0U; (CD_OK == ret) && (n < 70U); n++)
+	{
+	  for (size_t skew = 0U; (CD_OK == ret) && (skew < 2U); skew++)
+	    {
+	      pack_ref (order, ref, sam + skew, n);
+	      fn (buf + skew, sam + skew, n);
+	      if (0 != memcmp (ref, buf + skew, n * cd_sample_size))
+		{
+		  fprintf (stderr, "pack %s: mismatch, %lu samples!\n\n", name, (unsigned long) n);
+		  ret = CD_ERR_ARG;
+		}
+	    }
+	}
+
+      if (CD_OK == ret)
+	{
+	  pack_ref (order, ref, sam, len);
+	  fn (buf, sam, len);
+	  const double t0 = cd_clock ();
+	  for (int rep = 0; rep < PACK_CHECK_REPS; rep++)
+	    {
+	      fn (buf, sam, len);
+	    }
+	  const double t = (cd_clock () - t0) / PACK_CHECK_REPS;
+	  if (0 != memcmp (ref, buf, len * cd_sample_size))
+	    {
+	      fprintf (stderr, "pack %s: mismatch, %lu samples!\n\n", name, (unsigned long) len);
+	      ret = CD_ERR_ARG;
+	    }
+	  else
+	    {
+	      fprintf (out, "pack %-6s %s%s: ok %8.0f MB/s\n", name, (CD_ORDER_BE == order) ? "be" : "le", (ki < 2U) ? " (used)" : "",
+		       (double) (len * cd_sample_size) / 1e6 / (t > 0.0 ? t : 1e-9));
+	    }
+	}
+    }
+
+  free (buf);
+  free (ref);
+  free (sam);
+
+  return ret;
+}
@@ -0,0 +1,627 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Layout planner.  Every track start, length and INDEX point is fixed
+    here, before any audio is rendered, and the layout is checked against
+    frame alignment and the Red Book limits.  The plan is the disc model:
+    with the CD-TEXT resolved it is all the TOC and CUE are emitted from,
+    each built in one pass into a buffer and written at once.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cdgen_int.h"
+
+static const size_t tracks_max = 99U;
+static const size_t track_frames_min = 300U;	// 4 s
+
+static int plan_check_track (const cd_track_t * trk, const int trk_i);
+static int plan_track (cd_plan_t * plan, cd_plan_track_t * pt, const cd_track_t * trk, const int trk_i, size_t pos);
+
+/* Text being emitted, grown by doubling, err set once an allocation failed */
+typedef struct
+{
+  char *buf;
+  size_t len;
+  size_t cap;
+  int err;
+} plan_text_t;
+
+/* Description emitted from a plan, name is also the default file extension */
+typedef struct
+{
+  const char *name;
+  void (*emit) (const cd_plan_t * plan, plan_text_t * text, const char *dataname, const cd_format_t * fmt);
+} plan_emitter_t;
+
+static void text_put (plan_text_t * text, const char *str, size_t len);
+static void text_str (plan_text_t * text, const char *str);
+static void text_num (plan_text_t * text, size_t num, size_t width);
+static void text_msf (plan_text_t * text, size_t pos);
+static void plan_emit_toc (const cd_plan_t * plan, plan_text_t * text, const char *dataname, const cd_format_t * fmt);
+static void plan_emit_cue (const cd_plan_t * plan, plan_text_t * text, const char *dataname, const cd_format_t * fmt);
+static int plan_emit (const cd_plan_t * plan, const plan_emitter_t * em, const char *path, const char *base_name, const cd_format_t * fmt);
+
+static const plan_emitter_t plan_emitters[] = {
+  {"toc", plan_emit_toc},
+  {"cue", plan_emit_cue},
+};
+
+/* Generator parameters the kernels rely on */
+static int
+plan_check_track (const cd_track_t * trk, const int trk_i)
+{
+  int ret = CD_OK;
+  const cd_gen_t *gen = cd_gen_get (trk->type);
+
+  if (NULL == gen)
+    {
+      fprintf (stderr, "Track %02d: unknown generator %d\n", trk_i, (int) trk->type);
+      ret = CD_ERR_ARG;
+    }
+  else if (0U == trk->length)
+    {
+      fprintf (stderr, "Track %02d: %s track has no length\n", trk_i, gen->name);
+      ret = CD_ERR_ARG;
+    }
+  else if (CD_GEN_FM_STEP == trk->type)
+    {
+      size_t div = 2U;
+      for (size_t si = 1U; (si < trk->steps) && (0U < trk->ratio) && (div <= trk->period); si++)
+	{
+	  div *= trk->ratio;
+	}
+      if ((2U > trk->steps) || (2U > trk->ratio) || (div > trk->period))
+	{
+	  fprintf (stderr, "Track %02d: fm_step needs steps > 1, ratio > 1 and period >= 2 * ratio^(steps - 1)\n", trk_i);
+	  ret = CD_ERR_ARG;
+	}
+    }
+  else if (gen->period && ((2U > trk->period) || (trk->period % 2U)))
+    {
+      fprintf (stderr, "Track %02d: %s period must be even, got %lu\n", trk_i, gen->name, trk->period);
+      ret = CD_ERR_ARG;
+    }
+  else if ((CD_GEN_TRIANGLE == trk->type) && ((trk->period & (trk->period - 1U)) || (0x20000U < trk->period)))
+    {
+      fprintf (stderr, "Track %02d: triangle period must be a power of two up to 0x20000, got %lu\n", trk_i, trk->period);
+      ret = CD_ERR_ARG;
+    }
+  else if (((CD_GEN_AM_SINE == trk->type) || (CD_GEN_AM_TRIANGLE == trk->type)) && (0U == trk->carrier))
+    {
+      fprintf (stderr, "Track %02d: %s needs a carrier\n", trk_i, gen->name);
+      ret = CD_ERR_ARG;
+    }
+  else if ((CD_GEN_SILENCE == trk->type) && ((0U == trk->strips) || (trk->length % trk->strips)))
+    {
+      fprintf (stderr, "Track %02d: silence length %lu is not a whole number of %lu strips\n", trk_i, trk->length, trk->strips);
+      ret = CD_ERR_ARG;
+    }
+
+  return ret;
+}
+
+static int
+plan_track (cd_plan_t * plan, cd_plan_track_t * pt, const cd_track_t * trk, const int trk_i, size_t pos)
+{
+  int ret = plan_check_track (trk, trk_i);
+  const cd_gen_t *gen = cd_gen_get (trk->type);
+  size_t body = 0U;
+  size_t idx[CD_INDEX_MAX];
+  size_t idx_num = 0U;
+
+  pt->trk = trk;
+  pt->begin = pos;
+  pt->start = pos;
+
+  // Bounded by the disc first, the sample counts below cannot wrap then
+  if ((cd_disc_frames_max < trk->length) || (cd_disc_frames_max < trk->pregap))
+    {
+      fprintf (stderr, "Track %02d: length %lu or pregap %lu frames exceeds the Red Book disc maximum of %lu\n", trk_i, trk->length, trk->pregap,
+	       cd_disc_frames_max);
+      ret = CD_ERR_ARG;
+    }
+  else
+    {
+      body = trk->length * cd_frame_size;
+      pt->start = pos + (trk->pregap * cd_frame_size);
+    }
+
+  if (CD_OK == ret)
+    {
+      if (gen->period)
+	{
+	  // Periodic tracks are rendered in whole periods
+	  pt->period = gen->period (trk);
+	  if (cd_disc_frames_max * cd_frame_size < pt->period)
+	    {
+	      fprintf (stderr, "Track %02d: period of %lu samples exceeds the Red Book maximum disc length\n", trk_i, pt->period);
+	      ret = CD_ERR_ARG;
+	      pt->period = cd_frame_size;
+	    }
+	  body = (body + pt->period - 1U) / pt->period * pt->period;
+	  if (body % cd_frame_size)
+	    {
+	      fprintf (stderr, "Track %02d: %lu frames in whole periods of %lu samples is %lu samples, not frame aligned\n",
+		       trk_i, trk->length, pt->period, body);
+	      ret = CD_ERR_ARG;
+	    }
+	}
+      if (track_frames_min > (body / cd_frame_size))
+	{
+	  fprintf (stderr, "Track %02d: %lu frames is shorter than the Red Book minimum of %lu\n", trk_i, body / cd_frame_size, track_frames_min);
+	  ret = CD_ERR_ARG;
+	}
+
+      if (trk->index_num)
+	{
+	  for (; (idx_num < trk->index_num) && (idx_num < CD_INDEX_MAX); idx_num++)
+	    {
+	      // Past the disc the product could wrap, the track end fails the check below
+	      idx[idx_num] = (cd_disc_frames_max < trk->index[idx_num]) ? body : trk->index[idx_num] * cd_frame_size;
+	    }
+	  idx_num = trk->index_num;
+	}
+      else if (gen->indexes)
+	{
+	  idx_num = gen->indexes (trk, idx, CD_INDEX_MAX);
+	}
+
+      if (CD_INDEX_MAX - 1U < idx_num)
+	{
+	  fprintf (stderr, "Track %02d: %lu indexes, Red Book allows INDEX 02 to 99\n", trk_i, idx_num);
+	  ret = CD_ERR_ARG;
+	  idx_num = 0U;
+	}
+      size_t *index = cd_arena_alloc (&plan->arena, (idx_num ? idx_num : 1U) * sizeof (size_t));
+      for (size_t ii = 0U; index && (ii < idx_num); ii++)
+	{
+	  if ((0U == idx[ii]) || (body <= idx[ii]) || (ii && (idx[ii - 1U] >= idx[ii])))
+	    {
+	      fprintf (stderr, "Track %02d: INDEX %02lu at frame %lu is not ascending inside the track\n", trk_i, ii + 2U,
+		       trk->index_num ? trk->index[ii] : idx[ii] / cd_frame_size);
+	      ret = CD_ERR_ARG;
+	    }
+	  index[ii] = pt->start + idx[ii];
+	}
+      pt->index = index;
+      pt->index_num = idx_num;
+
+      // Generator descriptions unless the spec gives the CD-TEXT
+      char title[200];
+      char message[200];
+      char rem[100];
+
+      gen->describe (trk, title, sizeof (title), message, sizeof (message));
+      rem[0] = '\0';
+      if (gen->remark)
+	{
+	  gen->remark (trk, rem, sizeof (rem));
+	}
+      pt->title = cd_arena_strdup (&plan->arena, trk->title ? trk->title : title);
+      pt->message = cd_arena_strdup (&plan->arena, trk->message ? trk->message : message);
+      pt->performer = plan->performer;
+      pt->rem = rem[0] ? cd_arena_strdup (&plan->arena, rem) : NULL;
+      if ((NULL == index) || (NULL == pt->title) || (NULL == pt->message) || (rem[0] && (NULL == pt->rem)))
+	{
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  pt->end = pt->start + body;
+
+  return ret;
+}
+
+int
+cd_plan (const cd_disc_t * disc, cd_plan_t * plan)
+{
+  int ret = CD_OK;
+
+  memset (plan, 0, sizeof (*plan));
+  plan->disc = disc;
+
+  if ((0U == disc->tracks_num) || (tracks_max < disc->tracks_num))
+    {
+      fprintf (stderr, "Disc has %lu tracks, Red Book allows 1 to %lu\n", disc->tracks_num, tracks_max);
+      ret = CD_ERR_ARG;
+    }
+  else
+    {
+      plan->tracks = cd_arena_alloc (&plan->arena, disc->tracks_num * sizeof (cd_plan_track_t));
+      plan->title = cd_arena_strdup (&plan->arena, disc->title ? disc->title : "");
+      plan->performer = cd_arena_strdup (&plan->arena, disc->performer ? disc->performer : "");
+      plan->message = cd_arena_strdup (&plan->arena, disc->message ? disc->message : "");
+      if (plan->tracks && plan->title && plan->performer && plan->message)
+	{
+	  memset (plan->tracks, 0, disc->tracks_num * sizeof (cd_plan_track_t));
+	}
+      else
+	{
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      size_t pos = 0U;
+      size_t frames = 0U;
+
+      /*
+         Check every track so that one run reports every problem.  A track
+         spans at most a few disc lengths, so the frame total cannot wrap;
+         pos stops at the disc maximum and its sums cannot either.
+       */
+      for (size_t ti = 0U; ti < disc->tracks_num; ti++)
+	{
+	  const int track_ret = plan_track (plan, &plan->tracks[ti], &disc->tracks[ti], (int) ti + 1, pos);
+	  if (CD_OK != track_ret)
+	    {
+	      ret = (CD_ERR_MEM == ret) ? ret : track_ret;
+	    }
+	  frames += (plan->tracks[ti].end - plan->tracks[ti].begin) / cd_frame_size;
+	  if (cd_disc_frames_max >= frames)
+	    {
+	      pos = plan->tracks[ti].end;
+	    }
+	}
+      plan->tracks_num = disc->tracks_num;
+      plan->size = pos;
+
+      if (cd_disc_frames_max < frames)
+	{
+	  fprintf (stderr, "Disc length %02lu:%02lu:%02lu exceeds the Red Book maximum of 80 minutes\n", frames / 4500U, frames / 75U % 60U, frames % 75U);
+	  ret = CD_ERR_ARG;
+	}
+    }
+
+  if (CD_OK != ret)
+    {
+      cd_plan_free (plan);
+    }
+
+  return ret;
+}
+
+void
+cd_plan_free (cd_plan_t * plan)
+{
+  cd_arena_free (&plan->arena);
+  plan->tracks = NULL;
+  plan->tracks_num = 0U;
+}
+
+static void
+text_put (plan_text_t * text, const char *str, size_t len)
+{
+  if ((text->cap - text->len < len) && !text->err)
+    {
+      size_t cap = text->cap ? text->cap : 4096U;
+      while (cap - text->len < len)
+	{
+	  cap *= 2U;
+	}
+      char *buf = realloc (text->buf, cap);
+      if (buf)
+	{
+	  text->buf = buf;
+	  text->cap = cap;
+	}
+      else
+	{
+	  fprintf (stderr, "Memory allocation error(text): %s!\n\n", strerror (errno));
+	  text->err = 1;
+	}
+    }
+  if (!text->err)
+    {
+      memcpy (text->buf + text->len, str, len);
+      text->len += len;
+    }
+}
+
+static void
+text_str (plan_text_t * text, const char *str)
+{
+  text_put (text, str, strlen (str));
+}
+
+/* Decimal, zero padded to width */
+static void
+text_num (plan_text_t * text, size_t num, size_t width)
+{
+  char digits[24];
+  size_t pos = sizeof (digits);
+
+  do
+    {
+      digits[--pos] = (char) ('0' + num % 10U);
+      num /= 10U;
+    }
+  while ((0U < num) || (sizeof (digits) - pos < width));
+
+  text_put (text, digits + pos, sizeof (digits) - pos);
+}
+
+/* MM:SS:FF of a sample position */
+static void
+text_msf (plan_text_t * text, size_t pos)
+{
+  const trk_index_t idx = calculate_index (pos);
+
+  text_num (text, idx.m, 2U);
+  text_put (text, ":", 1U);
+  text_num (text, idx.s, 2U);
+  text_put (text, ":", 1U);
+  text_num (text, idx.f, 2U);
+}
+
+static void
+plan_emit_toc (const cd_plan_t * plan, plan_text_t * text, const char *dataname, const cd_format_t * fmt)
+{
+  text_str (text, "CD_DA\n\nCD_TEXT {\n  LANGUAGE_MAP {\n    0: 9\n  }\n  LANGUAGE 0 {\n    TITLE \"");
+  text_str (text, plan->title);
+  text_str (text, "\"\n    PERFORMER \"");
+  text_str (text, plan->performer);
+  text_str (text, "\"\n    MESSAGE \"");
+  text_str (text, plan->message);
+  text_str (text, "\"\n  }\n}\n");
+
+  for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+    {
+      const cd_plan_track_t *pt = &plan->tracks[ti];
+
+      text_str (text, "\n// Track ");
+      text_num (text, ti + 1U, 1U);
+      text_str (text, "\nTRACK AUDIO\nCOPY\nNO PRE_EMPHASIS\nTWO_CHANNEL_AUDIO\nCD_TEXT {\n  LANGUAGE 0 {\n    TITLE \"");
+      text_str (text, pt->title);
+      text_str (text, "\"\n    PERFORMER \"");
+      text_str (text, pt->performer);
+      text_str (text, "\"\n    MESSAGE \"");
+      text_str (text, pt->message);
+      text_str (text, "\"\n  }\n}\nFILE \"");
+      text_str (text, dataname);
+      text_str (text, fmt->ref_ext);
+      text_str (text, "\" ");
+      text_msf (text, pt->begin);
+      text_str (text, " ");
+      text_msf (text, pt->end - pt->begin);
+      text_str (text, "\n");
+
+      if (pt->start > pt->begin)
+	{
+	  text_str (text, "START ");
+	  text_msf (text, pt->start - pt->begin);
+	  text_str (text, "\n");
+	}
+      for (size_t ii = 0U; ii < pt->index_num; ii++)
+	{
+	  text_str (text, "INDEX ");
+	  text_msf (text, pt->index[ii] - pt->start);
+	  text_str (text, "\n");
+	}
+    }
+}
+
+static void
+plan_emit_cue (const cd_plan_t * plan, plan_text_t * text, const char *dataname, const cd_format_t * fmt)
+{
+  text_str (text, "PERFORMER \"");
+  text_str (text, plan->performer);
+  text_str (text, "\"\nTITLE \"");
+  text_str (text, plan->title);
+  text_str (text, "\"\nREM MESSAGE \"");
+  text_str (text, plan->message);
+  text_str (text, "\"\nFILE \"");
+  text_str (text, dataname);
+  text_str (text, fmt->ref_ext);
+  text_str (text, "\" ");
+  text_str (text, fmt->cue_type);
+  text_str (text, "\n");
+
+  for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+    {
+      const cd_plan_track_t *pt = &plan->tracks[ti];
+
+      text_str (text, "  TRACK ");
+      text_num (text, ti + 1U, 2U);
+      text_str (text, " AUDIO\n    TITLE \"");
+      text_str (text, pt->title);
+      text_str (text, "\"\n    PERFORMER \"");
+      text_str (text, pt->performer);
+      text_str (text, "\"\n    REM MESSAGE \"");
+      text_str (text, pt->message);
+      text_str (text, "\"\n    FLAGS DCP\n");
+      if (pt->rem)
+	{
+	  text_str (text, "    REM ");
+	  text_str (text, pt->rem);
+	  text_str (text, "\n");
+	}
+
+      if (pt->start > pt->begin)
+	{
+	  text_str (text, "    INDEX 00 ");
+	  text_msf (text, pt->begin);
+	  text_str (text, "\n");
+	}
+      text_str (text, "    INDEX 01 ");
+      text_msf (text, pt->start);
+      text_str (text, "\n");
+      for (size_t ii = 0U; ii < pt->index_num; ii++)
+	{
+	  text_str (text, "    INDEX ");
+	  text_num (text, ii + 2U, 2U);
+	  text_str (text, " ");
+	  text_msf (text, pt->index[ii]);
+	  text_str (text, "\n");
+	}
+    }
+}
+
+/* Emit one description and write it to path, or to base_name with the emitter's extension */
+static int
+plan_emit (const cd_plan_t * plan, const plan_emitter_t * em, const char *path, const char *base_name, const cd_format_t * fmt)
+{
+  int ret = CD_OK;
+  plan_text_t text;
+  char ext[16];
+  FILE *out = NULL;
+
+  memset (&text, 0, sizeof (text));
+  em->emit (plan, &text, base_name, fmt);
+  snprintf (ext, sizeof (ext), ".%s", em->name);
+  char *name = path ? strdup (path) : cd_make_name (base_name, ext);
+
+  if (text.err || (NULL == name))
+    {
+      fprintf (stderr, "Error allocating memory\n\n");
+      ret = CD_ERR_MEM;
+    }
+  else if (NULL == (out = fopen (name, "wt")))
+    {
+      fprintf (stderr, "Error opening files!\nTerminating!!!\n\n");
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      if ((text.len != fwrite (text.buf, 1U, text.len, out)) | (0 != fclose (out)))
+	{
+	  fprintf (stderr, "Write error (%s): %s!\n\n", em->name, strerror (errno));
+	  ret = CD_ERR_FILE;
+	}
+    }
+
+  free (name);
+  free (text.buf);
+
+  return ret;
+}
+
+/*
+    TOC and CUE go to <base>.toc and <base>.cue unless opt gives other
+    paths, and reference the image in the first container opt selects.
+    opt may be NULL.
+*/
+int
+cd_plan_write (const cd_plan_t * plan, const char *base_name, const cd_options_t * opt)
+{
+  int ret = CD_OK;
+  const cd_format_t *fmt = cd_format_find ((opt && opt->format_num) ? opt->format[0] : "cdr");
+
+  for (size_t ei = 0U; (CD_OK == ret) && (ei < sizeof (plan_emitters) / sizeof (plan_emitters[0])); ei++)
+    {
+      const char *path = NULL;
+
+      if (opt && (0 == strcmp (plan_emitters[ei].name, "toc")))
+	{
+	  path = opt->toc;
+	}
+      else if (opt && (0 == strcmp (plan_emitters[ei].name, "cue")))
+	{
+	  path = opt->cue;
+	}
+      ret = plan_emit (plan, &plan_emitters[ei], path, base_name, fmt);
+    }
+
+  return ret;
+}
+
+/* Plan, write the TOC and CUE and report the image size, no audio */
+int
+cd_dry_run (const cd_disc_t * disc, const char *base_name, const cd_options_t * opt)
+{
+  cd_plan_t plan;
+  int ret = cd_plan (disc, &plan);
+
+  if (CD_OK == ret)
+    {
+      ret = cd_plan_write (&plan, base_name, opt);
+    }
+  if (CD_OK == ret)
+    {
+      const unsigned long long ms = (unsigned long long) plan.size * 1000ULL / (unsigned long long) cd_fd;
+      printf ("%s: %lu tracks, %lu frames, %llu ms, %llu bytes\n", base_name, plan.tracks_num, plan.size / cd_frame_size, ms,
+	      (unsigned long long) plan.size * (unsigned long long) cd_sample_size);
+    }
+
+  cd_plan_free (&plan);
+
+  return ret;
+}
+
+/*
+    Plan discs whose frame counts would wrap the sample positions, each
+    must be refused, and one just inside the limits, which must not.
+    The refused ones print their diagnostics as usual.
+*/
+int
+cd_plan_check (FILE * out)
+{
+  int ret = CD_OK;
+  cd_track_t tracks[tracks_max];
+  const struct
+  {
+    const char *name;
+    size_t length;
+    size_t pregap;
+    size_t tracks_num;
+    int ret;
+  } cases[] = {
+    {"huge pregap", track_frames_min, SIZE_MAX, 1U, CD_ERR_ARG},
+    {"wrapping pregap", track_frames_min, SIZE_MAX / cd_frame_size + 1U, 1U, CD_ERR_ARG},
+    {"huge length", SIZE_MAX, 0U, 1U, CD_ERR_ARG},
+    {"wrapping length", SIZE_MAX / cd_frame_size + 1U, 0U, 1U, CD_ERR_ARG},
+    {"longest tracks", cd_disc_frames_max, cd_disc_frames_max, tracks_max, CD_ERR_ARG},
+    {"full disc", cd_disc_frames_max - 150U, 150U, 1U, CD_OK},
+  };
+
+  for (size_t ci = 0U; (CD_OK == ret) && (ci < sizeof (cases) / sizeof (cases[0])); ci++)
+    {
+      cd_disc_t disc;
+      cd_plan_t plan;
+
+      memset (&disc, 0, sizeof (disc));
+      memset (tracks, 0, sizeof (tracks));
+      for (size_t ti = 0U; ti < cases[ci].tracks_num; ti++)
+	{
+	  tracks[ti].type = CD_GEN_TONE;
+	  tracks[ti].length = cases[ci].length;
+	  tracks[ti].pregap = cases[ci].pregap;
+	  tracks[ti].period = 2U;
+	}
+      disc.tracks = tracks;
+      disc.tracks_num = cases[ci].tracks_num;
+
+      const int plan_ret = cd_plan (&disc, &plan);
+      if ((plan_ret != cases[ci].ret) || ((CD_OK == plan_ret) && (cd_disc_frames_max * cd_frame_size != plan.size)))
+	{
+	  fprintf (stderr, "plan %s: got %d, expected %d!\n\n", cases[ci].name, plan_ret, cases[ci].ret);
+	  ret = CD_ERR_ARG;
+	}
+      cd_plan_free (&plan);
+    }
+  if (CD_OK == ret)
+    {
+      fprintf (out, "plan limits: ok\n");
+    }
+
+  return ret;
+}
@@ -0,0 +1,168 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Fixed size worker pool.  cd_pool_run() hands out the indexes 0 to
+    num - 1 to the workers in order and returns once all are done, with
+    the first error any of them returned.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "cdgen_int.h"
+
+struct cd_pool
+{
+  pthread_t *threads;
+  size_t threads_num;
+  pthread_mutex_t lock;
+  pthread_cond_t work;
+  pthread_cond_t done;
+  int (*fn) (void *arg, size_t i);
+  void *arg;
+  size_t next;
+  size_t num;
+  size_t finished;
+  int ret;
+  int quit;
+};
+
+static void *pool_worker (void *arg);
+
+static void *
+pool_worker (void *arg)
+{
+  cd_pool_t *pool = arg;
+
+  pthread_mutex_lock (&pool->lock);
+  for (;;)
+    {
+      while (!pool->quit && (pool->next >= pool->num))
+	{
+	  pthread_cond_wait (&pool->work, &pool->lock);
+	}
+      if (pool->quit)
+	{
+	  break;
+	}
+
+      const size_t i = pool->next++;
+      pthread_mutex_unlock (&pool->lock);
+      int ret = pool->fn (pool->arg, i);
+      pthread_mutex_lock (&pool->lock);
+
+      if ((CD_OK != ret) && (CD_OK == pool->ret))
+	{
+	  pool->ret = ret;
+	}
+      if (++pool->finished == pool->num)
+	{
+	  pthread_cond_signal (&pool->done);
+	}
+    }
+  pthread_mutex_unlock (&pool->lock);
+
+  return NULL;
+}
+
+cd_pool_t *
+cd_pool_new (size_t threads)
+{
+  cd_pool_t *pool = calloc (1U, sizeof (cd_pool_t));
+
+  if (pool)
+    {
+      pthread_mutex_init (&pool->lock, NULL);
+      pthread_cond_init (&pool->work, NULL);
+      pthread_cond_init (&pool->done, NULL);
+      pool->threads = calloc (threads, sizeof (pthread_t));
+    }
+
+  for (size_t ti = 0U; pool && pool->threads && (ti < threads); ti++)
+    {
+      int cr_ret = pthread_create (&pool->threads[ti], NULL, pool_worker, pool);
+      if (0 == cr_ret)
+	{
+	  pool->threads_num++;
+	}
+      else
+	{
+	  fprintf (stderr, "Thread creation error: %s!\n\n", strerror (cr_ret));
+	  break;
+	}
+    }
+
+  if (pool && (0U == pool->threads_num))
+    {
+      fprintf (stderr, "Memory allocation error(pool): %s!\n\n", strerror (errno));
+      cd_pool_free (pool);
+      pool = NULL;
+    }
+
+  return pool;
+}
+
+void
+cd_pool_free (cd_pool_t * pool)
+{
+  if (pool)
+    {
+      pthread_mutex_lock (&pool->lock);
+      pool->quit = 1;
+      pthread_cond_broadcast (&pool->work);
+      pthread_mutex_unlock (&pool->lock);
+
+      for (size_t ti = 0U; ti < pool->threads_num; ti++)
+	{
+	  pthread_join (pool->threads[ti], NULL);
+	}
+
+      pthread_cond_destroy (&pool->work);
+      pthread_cond_destroy (&pool->done);
+      pthread_mutex_destroy (&pool->lock);
+      free (pool->threads);
+      free (pool);
+    }
+}
+
+int
+cd_pool_run (cd_pool_t * pool, int (*fn) (void *arg, size_t i), void *arg, size_t num)
+{
+  int ret = CD_OK;
+
+  pthread_mutex_lock (&pool->lock);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->next = 0U;
+  pool->finished = 0U;
+  pool->ret = CD_OK;
+  pool->num = num;
+  pthread_cond_broadcast (&pool->work);
+  while (pool->finished < pool->num)
+    {
+      pthread_cond_wait (&pool->done, &pool->lock);
+    }
+  ret = pool->ret;
+  pool->num = 0U;
+  pool->next = 0U;
+  pthread_mutex_unlock (&pool->lock);
+
+  return ret;
+}
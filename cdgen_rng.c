@@ -0,0 +1,581 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Random number generators of the noise tracks.  Philox4x32-10 from
+    Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", is a
+    keyed bijection of a 128 bit counter, so the random bits at any
+    position of a track are computed on their own, without the state of
+    the positions before it.
+
+    The legacy noise follows glibc's random() with the default TYPE_3
+    state: r[0] is the seed, r[1..30] the Park-Miller sequence from it,
+    r[31..33] repeat r[0..2], and r[i] = r[i - 3] + r[i - 31] mod 2^32
+    afterwards.  Draw k returns r[k + 344] >> 1.  The recurrence is
+    linear, so r at any index is a combination of r[3..33] with the
+    coefficients of x^n mod x^31 - x^28 - 1, which is how a generator
+    is seeked.  Its nearest term is 3 back, too close for SIMD along one
+    sequence, so bulk fills split the range into CD_GLIBC_LANES
+    segments, seek one lane to each and step all of them at once.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CD_RNG_X86 1
+#include <immintrin.h>
+#endif
+
+#include "cdgen_int.h"
+
+#define GLIBC_DEG (31)		// Recurrence depth
+#define GLIBC_SKIP (344)	// r index of draw 0
+#define GLIBC_CHUNK (256U)	// Lane steps per kernel call
+#define GLIBC_LANE_MIN (4096U)	// Draws per lane below which a fill stays sequential
+
+typedef uint32_t glibc_row_t[CD_GLIBC_LANES];
+typedef void (*glibc_fn_t) (glibc_row_t * r, size_t n, int32_t * out, size_t stride);
+
+typedef struct
+{
+  const char *name;
+  int (*supported) (void);
+  glibc_fn_t fn;
+} glibc_kernel_t;
+
+static void glibc_base (unsigned int seed, uint32_t base[GLIBC_DEG]);
+static void poly_mulmod (uint32_t a[GLIBC_DEG], const uint32_t b[GLIBC_DEG]);
+static void poly_mulx (uint32_t a[GLIBC_DEG]);
+static void glibc_pow (uint64_t n, uint32_t c[GLIBC_DEG]);
+static void glibc_jump (const uint32_t c[GLIBC_DEG], const uint32_t * in, uint32_t out[CD_GLIBC_HIST]);
+static void glibc_fill_with (unsigned int seed, uint64_t draw, glibc_fn_t fn, int32_t * out, size_t n);
+static void glibc_scalar (glibc_row_t * r, size_t n, int32_t * out, size_t stride);
+static int glibc_any (void);
+#ifdef CD_RNG_X86
+static void glibc_sse2 (glibc_row_t * r, size_t n, int32_t * out, size_t stride);
+static void glibc_avx2 (glibc_row_t * r, size_t n, int32_t * out, size_t stride);
+static int glibc_has_avx2 (void);
+#endif
+static void glibc_init (void);
+
+// Lane kernels, best first, the first supported one is used
+static const glibc_kernel_t glibc_kernels[] = {
+#ifdef CD_RNG_X86
+  {"avx2", glibc_has_avx2, glibc_avx2},
+  {"sse2", glibc_any, glibc_sse2},
+#endif
+  {"scalar", glibc_any, glibc_scalar},
+};
+
+static pthread_once_t glibc_once = PTHREAD_ONCE_INIT;
+static const glibc_kernel_t *glibc_sel;
+static uint32_t glibc_x2k[64][GLIBC_DEG];	// x^(2^k)
+
+#define PHILOX_M0 (0xD2511F53U)
+#define PHILOX_M1 (0xCD9E8D57U)
+#define PHILOX_W0 (0x9E3779B9U)
+#define PHILOX_W1 (0xBB67AE85U)
+#define PHILOX_ROUNDS (10)
+
+void
+cd_philox (const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+  uint32_t c0 = ctr[0];
+  uint32_t c1 = ctr[1];
+  uint32_t c2 = ctr[2];
+  uint32_t c3 = ctr[3];
+  uint32_t k0 = key[0];
+  uint32_t k1 = key[1];
+
+  for (int r = 0; r < PHILOX_ROUNDS; r++)
+    {
+      const uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+      const uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+
+      c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+      c1 = (uint32_t) p1;
+      c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+      c3 = (uint32_t) p0;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/* r[3..33] from the seed, as srandom_r() fills the state */
+static void
+glibc_base (unsigned int seed, uint32_t base[GLIBC_DEG])
+{
+  uint32_t r[GLIBC_DEG + 3];
+  int32_t word = (int32_t) (seed ? seed : 1U);
+
+  r[0] = (uint32_t) word;
+  for (int i = 1; i < GLIBC_DEG; i++)
+    {
+      const long hi = word / 127773;
+      const long lo = word % 127773;
+
+      word = (int32_t) (16807 * lo - 2836 * hi);
+      if (word < 0)
+	{
+	  word += 2147483647;
+	}
+      r[i] = (uint32_t) word;
+    }
+  for (int i = GLIBC_DEG; i < GLIBC_DEG + 3; i++)
+    {
+      r[i] = r[i - GLIBC_DEG];
+    }
+  memcpy (base, r + 3, sizeof (uint32_t) * GLIBC_DEG);
+}
+
+/* a = a * b mod x^31 - x^28 - 1 */
+static void
+poly_mulmod (uint32_t a[GLIBC_DEG], const uint32_t b[GLIBC_DEG])
+{
+  uint32_t t[2 * GLIBC_DEG - 1];
+
+  memset (t, 0, sizeof (t));
+  for (int i = 0; i < GLIBC_DEG; i++)
+    {
+      for (int j = 0; j < GLIBC_DEG; j++)
+	{
+	  t[i + j] += a[i] * b[j];
+	}
+    }
+  for (int d = 2 * GLIBC_DEG - 2; d >= GLIBC_DEG; d--)
+    {
+      t[d - 3] += t[d];
+      t[d - GLIBC_DEG] += t[d];
+    }
+  memcpy (a, t, sizeof (uint32_t) * GLIBC_DEG);
+}
+
+/* a = a * x mod x^31 - x^28 - 1 */
+static void
+poly_mulx (uint32_t a[GLIBC_DEG])
+{
+  const uint32_t top = a[GLIBC_DEG - 1];
+
+  memmove (a + 1, a, sizeof (uint32_t) * (GLIBC_DEG - 1));
+  a[0] = top;
+  a[GLIBC_DEG - 3] += top;
+}
+
+/* c = x^n mod x^31 - x^28 - 1, one product per set bit of n */
+static void
+glibc_pow (uint64_t n, uint32_t c[GLIBC_DEG])
+{
+  pthread_once (&glibc_once, glibc_init);
+  memset (c, 0, sizeof (uint32_t) * GLIBC_DEG);
+  c[0] = 1U;
+  for (int k = 0; k < 64; k++)
+    {
+      if ((n >> k) & 1U)
+	{
+	  poly_mulmod (c, glibc_x2k[k]);
+	}
+    }
+}
+
+/* out = r[m + n .. m + n + CD_GLIBC_HIST) from in = r[m .. m + 31) and c = x^n */
+static void
+glibc_jump (const uint32_t c[GLIBC_DEG], const uint32_t * in, uint32_t out[CD_GLIBC_HIST])
+{
+  uint32_t cj[GLIBC_DEG];
+
+  memcpy (cj, c, sizeof (cj));
+  for (int j = 0; j < GLIBC_DEG; j++)
+    {
+      uint32_t v = 0U;
+      for (int k = 0; k < GLIBC_DEG; k++)
+	{
+	  v += cj[k] * in[k];
+	}
+      out[j] = v;
+      poly_mulx (cj);
+    }
+  for (int j = GLIBC_DEG; j < CD_GLIBC_HIST; j++)
+    {
+      out[j] = out[j - 3] + out[j - GLIBC_DEG];
+    }
+}
+
+/* Position rnd so that its next draw is draw number draw after srandom (seed) */
+void
+cd_glibc_seek (cd_glibc_t * rnd, unsigned int seed, uint64_t draw)
+{
+  uint32_t base[GLIBC_DEG];
+  uint32_t c[GLIBC_DEG];
+
+  glibc_base (seed, base);
+  glibc_pow (draw + GLIBC_SKIP - CD_GLIBC_HIST - 3U, c);
+  glibc_jump (c, base, rnd->hist);
+}
+
+/* The next n values random() would return, one after the other */
+void
+cd_glibc_draw (cd_glibc_t * rnd, int32_t * out, size_t n)
+{
+  uint32_t *h = rnd->hist;
+
+  for (size_t i = 0U; i < n; i++)
+    {
+      const uint32_t v = h[CD_GLIBC_HIST - 3] + h[CD_GLIBC_HIST - GLIBC_DEG];
+
+      memmove (h, h + 1, sizeof (uint32_t) * (CD_GLIBC_HIST - 1));
+      h[CD_GLIBC_HIST - 1] = v;
+      out[i] = (int32_t) (v >> 1);
+    }
+}
+
+/*
+    Step every lane n times, rows CD_GLIBC_HIST onwards from the rows
+    before them, and store the draws of lane l at out + l * stride.
+*/
+static void
+glibc_scalar (glibc_row_t * r, size_t n, int32_t * out, size_t stride)
+{
+  for (size_t i = CD_GLIBC_HIST; i < CD_GLIBC_HIST + n; i++)
+    {
+      for (size_t l = 0U; l < CD_GLIBC_LANES; l++)
+	{
+	  r[i][l] = r[i - 3][l] + r[i - GLIBC_DEG][l];
+	  out[l * stride + i - CD_GLIBC_HIST] = (int32_t) (r[i][l] >> 1);
+	}
+    }
+}
+
+static int
+glibc_any (void)
+{
+  return 1;
+}
+
+#ifdef CD_RNG_X86
+/* Lanes as two halves of 4, 4 steps at a time transposed into 4 runs of 4 draws */
+__attribute__((target ("sse2")))
+static void
+glibc_sse2 (glibc_row_t * r, size_t n, int32_t * out, size_t stride)
+{
+  size_t i = CD_GLIBC_HIST;
+
+  for (; i + 4U <= CD_GLIBC_HIST + n; i += 4U)
+    {
+      for (size_t h = 0U; h < CD_GLIBC_LANES; h += 4U)
+	{
+	  __m128i v[4];
+
+	  for (size_t k = 0U; k < 4U; k++)
+	    {
+	      v[k] = _mm_add_epi32 (_mm_load_si128 ((const __m128i *) &r[i + k - 3][h]), _mm_load_si128 ((const __m128i *) &r[i + k - GLIBC_DEG][h]));
+	      _mm_store_si128 ((__m128i *) & r[i + k][h], v[k]);
+	    }
+
+	  const __m128i t0 = _mm_unpacklo_epi32 (v[0], v[1]);
+	  const __m128i t1 = _mm_unpackhi_epi32 (v[0], v[1]);
+	  const __m128i t2 = _mm_unpacklo_epi32 (v[2], v[3]);
+	  const __m128i t3 = _mm_unpackhi_epi32 (v[2], v[3]);
+	  int32_t *dst = out + h * stride + i - CD_GLIBC_HIST;
+
+	  _mm_storeu_si128 ((__m128i *) dst, _mm_srli_epi32 (_mm_unpacklo_epi64 (t0, t2), 1));
+	  _mm_storeu_si128 ((__m128i *) (dst + stride), _mm_srli_epi32 (_mm_unpackhi_epi64 (t0, t2), 1));
+	  _mm_storeu_si128 ((__m128i *) (dst + 2U * stride), _mm_srli_epi32 (_mm_unpacklo_epi64 (t1, t3), 1));
+	  _mm_storeu_si128 ((__m128i *) (dst + 3U * stride), _mm_srli_epi32 (_mm_unpackhi_epi64 (t1, t3), 1));
+	}
+    }
+  glibc_scalar (r + i - CD_GLIBC_HIST, CD_GLIBC_HIST + n - i, out + i - CD_GLIBC_HIST, stride);
+}
+
+/* 8 steps at a time, transposed into 8 runs of 8 draws */
+__attribute__((target ("avx2")))
+static void
+glibc_avx2 (glibc_row_t * r, size_t n, int32_t * out, size_t stride)
+{
+  size_t i = CD_GLIBC_HIST;
+
+  for (; i + 8U <= CD_GLIBC_HIST + n; i += 8U)
+    {
+      __m256i v[8];
+      __m256i t[8];
+      __m256i u[8];
+      int32_t *dst = out + i - CD_GLIBC_HIST;
+
+      for (size_t k = 0U; k < 8U; k++)
+	{
+	  v[k] = _mm256_add_epi32 (_mm256_load_si256 ((const __m256i *) r[i + k - 3]), _mm256_load_si256 ((const __m256i *) r[i + k - GLIBC_DEG]));
+	  _mm256_store_si256 ((__m256i *) r[i + k], v[k]);
+	}
+      for (size_t k = 0U; k < 8U; k += 2U)
+	{
+	  t[k] = _mm256_unpacklo_epi32 (v[k], v[k + 1U]);
+	  t[k + 1U] = _mm256_unpackhi_epi32 (v[k], v[k + 1U]);
+	}
+      for (size_t k = 0U; k < 8U; k += 4U)
+	{
+	  u[k] = _mm256_unpacklo_epi64 (t[k], t[k + 2U]);
+	  u[k + 1U] = _mm256_unpackhi_epi64 (t[k], t[k + 2U]);
+	  u[k + 2U] = _mm256_unpacklo_epi64 (t[k + 1U], t[k + 3U]);
+	  u[k + 3U] = _mm256_unpackhi_epi64 (t[k + 1U], t[k + 3U]);
+	}
+      for (size_t l = 0U; l < 4U; l++)
+	{
+	  _mm256_storeu_si256 ((__m256i *) (dst + l * stride), _mm256_srli_epi32 (_mm256_permute2x128_si256 (u[l], u[l + 4U], 0x20), 1));
+	  _mm256_storeu_si256 ((__m256i *) (dst + (l + 4U) * stride), _mm256_srli_epi32 (_mm256_permute2x128_si256 (u[l], u[l + 4U], 0x31), 1));
+	}
+    }
+  glibc_scalar (r + i - CD_GLIBC_HIST, CD_GLIBC_HIST + n - i, out + i - CD_GLIBC_HIST, stride);
+}
+
+static int
+glibc_has_avx2 (void)
+{
+  return __builtin_cpu_supports ("avx2");
+}
+#endif
+
+static void
+glibc_init (void)
+{
+  for (size_t ki = 0U; (NULL == glibc_sel) && (ki < sizeof (glibc_kernels) / sizeof (glibc_kernels[0])); ki++)
+    {
+      if (glibc_kernels[ki].supported ())
+	{
+	  glibc_sel = &glibc_kernels[ki];
+	}
+    }
+
+  glibc_x2k[0][1] = 1U;
+  for (int k = 1; k < 64; k++)
+    {
+      memcpy (glibc_x2k[k], glibc_x2k[k - 1], sizeof (glibc_x2k[k]));
+      poly_mulmod (glibc_x2k[k], glibc_x2k[k - 1]);
+    }
+}
+
+/*
+    n draws from draw on.  Long fills run CD_GLIBC_LANES segments side by
+    side, the last lane ends where the sequential tail starts.
+*/
+static void
+glibc_fill_with (unsigned int seed, uint64_t draw, glibc_fn_t fn, int32_t * out, size_t n)
+{
+  cd_glibc_t rnd;
+  const size_t seg = (GLIBC_LANE_MIN * CD_GLIBC_LANES <= n) ? (n / CD_GLIBC_LANES) : 0U;
+
+  cd_glibc_seek (&rnd, seed, draw);
+  if (0U < seg)
+    {
+      glibc_row_t r[CD_GLIBC_HIST + GLIBC_CHUNK] __attribute__((aligned (32)));
+      uint32_t c[GLIBC_DEG];
+
+      glibc_pow (seg, c);
+      for (size_t l = 0U; l < CD_GLIBC_LANES; l++)
+	{
+	  uint32_t start[GLIBC_DEG];
+
+	  for (size_t j = 0U; j < CD_GLIBC_HIST; j++)
+	    {
+	      r[j][l] = rnd.hist[j];
+	    }
+	  memcpy (start, rnd.hist, sizeof (start));
+	  glibc_jump (c, start, rnd.hist);
+	}
+
+      for (size_t t = 0U; t < seg; t += GLIBC_CHUNK)
+	{
+	  const size_t len = (seg - t < GLIBC_CHUNK) ? (seg - t) : GLIBC_CHUNK;
+
+	  fn (r, len, out + t, seg);
+	  memmove (r, r + len, sizeof (glibc_row_t) * CD_GLIBC_HIST);
+	}
+    }
+  cd_glibc_draw (&rnd, out + CD_GLIBC_LANES * seg, n - CD_GLIBC_LANES * seg);
+}
+
+/* n values random() would return from draw number draw after srandom (seed) on */
+void
+cd_glibc_fill (unsigned int seed, uint64_t draw, int32_t * out, size_t n)
+{
+  pthread_once (&glibc_once, glibc_init);
+  glibc_fill_with (seed, draw, glibc_sel->fn, out, n);
+}
+
+/* Philox known answers from the Random123 distribution */
+static int
+rng_check_philox (FILE * out)
+{
+  int ret = CD_OK;
+  static const struct
+  {
+    uint32_t ctr[4];
+    uint32_t key[2];
+    uint32_t out[4];
+  } kat[] = {
+    {{0U, 0U, 0U, 0U}, {0U, 0U}, {0x6627e8d5U, 0xe169c58dU, 0xbc57ac4cU, 0x9b00dbd8U}},
+    {{0xffffffffU, 0xffffffffU, 0xffffffffU, 0xffffffffU}, {0xffffffffU, 0xffffffffU}, {0x408f276dU, 0x41c83b0eU, 0xa20bc7c6U, 0x6d5451fdU}},
+    {{0x243f6a88U, 0x85a308d3U, 0x13198a2eU, 0x03707344U}, {0xa4093822U, 0x299f31d0U}, {0xd16cfe09U, 0x94fdccebU, 0x5001e420U, 0x24126ea1U}},
+  };
+
+  for (size_t ki = 0U; ki < sizeof (kat) / sizeof (kat[0]); ki++)
+    {
+      uint32_t res[4];
+
+      cd_philox (kat[ki].ctr, kat[ki].key, res);
+      if (0 != memcmp (res, kat[ki].out, sizeof (res)))
+	{
+	  fprintf (stderr, "philox4x32-10: known answer %lu mismatch!\n\n", (unsigned long) ki);
+	  ret = CD_ERR_ARG;
+	}
+    }
+  if (CD_OK == ret)
+    {
+      fprintf (out, "rng philox4x32-10: ok\n");
+    }
+
+  return ret;
+}
+
+/*
+    Compare every lane kernel and the sequential draw with random_r()
+    for a few seeds, from the start and after seeking to odd draws,
+    check a far seek against a nearer one drawn forward, and time the
+    kernels against random_r().
+*/
+static int
+rng_check_glibc (FILE * out)
+{
+  int ret = CD_OK;
+  static const unsigned int seeds[] = { 0xb1e27b68U, 0U, 1U, 0x80000000U, 0xffffffffU };
+  static const size_t seeks[] = { 0U, 1U, 2U, 3U, 30U, 31U, 37U, 343U, 344U, 1000U, 65537U };
+  const size_t len = 1U << 20;
+  const size_t kernels_num = sizeof (glibc_kernels) / sizeof (glibc_kernels[0]);
+  int32_t *ref = malloc (len * sizeof (int32_t));
+  int32_t *res = malloc (len * sizeof (int32_t));
+  double t_ref = 0.0;
+
+  if ((NULL == ref) || (NULL == res))
+    {
+      fprintf (stderr, "Memory allocation error(rng): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  pthread_once (&glibc_once, glibc_init);
+  for (size_t si = 0U; (CD_OK == ret) && (si < sizeof (seeds) / sizeof (seeds[0])); si++)
+    {
+      struct random_data rd;
+      char rd_state[128];	// TYPE_3, the srandom() default
+
+      memset (&rd, 0, sizeof (rd));
+      initstate_r (seeds[si], rd_state, sizeof (rd_state), &rd);
+      const double t0 = cd_clock ();
+      for (size_t i = 0U; i < len; i++)
+	{
+	  random_r (&rd, &ref[i]);
+	}
+      t_ref += cd_clock () - t0;
+
+      for (size_t ei = 0U; (CD_OK == ret) && (ei < sizeof (seeks) / sizeof (seeks[0])); ei++)
+	{
+	  cd_glibc_t rnd;
+
+	  cd_glibc_seek (&rnd, seeds[si], seeks[ei]);
+	  cd_glibc_draw (&rnd, res, 4099U);
+	  if (0 != memcmp (ref + seeks[ei], res, 4099U * sizeof (int32_t)))
+	    {
+	      fprintf (stderr, "random: mismatch, seed 0x%08X draw %lu!\n\n", seeds[si], (unsigned long) seeks[ei]);
+	      ret = CD_ERR_ARG;
+	    }
+	  for (size_t ki = 0U; (CD_OK == ret) && (ki < kernels_num); ki++)
+	    {
+	      const size_t n = len - seeks[ei] - 5U;
+
+	      if (glibc_kernels[ki].supported ())
+		{
+		  glibc_fill_with (seeds[si], seeks[ei], glibc_kernels[ki].fn, res, n);
+		  if (0 != memcmp (ref + seeks[ei], res, n * sizeof (int32_t)))
+		    {
+		      fprintf (stderr, "random %s: mismatch, seed 0x%08X draw %lu!\n\n", glibc_kernels[ki].name, seeds[si], (unsigned long) seeks[ei]);
+		      ret = CD_ERR_ARG;
+		    }
+		}
+	    }
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      cd_glibc_t near;
+
+      cd_glibc_fill (seeds[0], (1ULL << 40) + 5U, res, 1000U);
+      cd_glibc_seek (&near, seeds[0], (1ULL << 40) - 3000U);
+      cd_glibc_draw (&near, ref, 3005U);
+      cd_glibc_draw (&near, ref, 1000U);
+      if (0 != memcmp (res, ref, 1000U * sizeof (int32_t)))
+	{
+	  fprintf (stderr, "random: seek past 2^40 mismatch!\n\n");
+	  ret = CD_ERR_ARG;
+	}
+    }
+
+  for (size_t ki = 0U; (CD_OK == ret) && (ki < kernels_num); ki++)
+    {
+      if (!glibc_kernels[ki].supported ())
+	{
+	  fprintf (out, "random %-6s: not supported\n", glibc_kernels[ki].name);
+	  continue;
+	}
+
+      const double t0 = cd_clock ();
+      for (size_t si = 0U; si < sizeof (seeds) / sizeof (seeds[0]); si++)
+	{
+	  glibc_fill_with (seeds[0], si * len, glibc_kernels[ki].fn, res, len);
+	}
+      const double t = cd_clock () - t0;
+      fprintf (out, "random %-6s: ok %8.1f M/s%s\n", glibc_kernels[ki].name, (double) len * 5.0 / 1e6 / (t > 0.0 ? t : 1e-9),
+	       (glibc_sel == &glibc_kernels[ki]) ? " (used)" : "");
+    }
+  if (CD_OK == ret)
+    {
+      fprintf (out, "random libc  :    %8.1f M/s\n", (double) len * 5.0 / 1e6 / (t_ref > 0.0 ? t_ref : 1e-9));
+    }
+
+  free (res);
+  free (ref);
+
+  return ret;
+}
+
+int
+cd_rng_check (FILE * out)
+{
+  int ret = rng_check_philox (out);
+
+  if (CD_OK == ret)
+    {
+      ret = rng_check_glibc (out);
+    }
+
+  return ret;
+}
@@ -0,0 +1,394 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Sine and cosine of arrays of doubles.  The argument is reduced by
+    k * pi/2 with a three part Cody-Waite split and evaluated with the
+    fdlibm minimax polynomials on [-pi/4, pi/4], a few ulp from libm.
+    Arguments beyond SIN_REDUCE_MAX go to libm.  On x86 the widest of
+    AVX-512 and AVX2 with FMA the CPU has is picked once at first use,
+    the portable loop runs everywhere else.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#define CD_SIN_X86 1
+#include <immintrin.h>
+#endif
+
+#include "cdgen_int.h"
+
+typedef void (*sin_fn_t) (const double *x, double *s, double *c, size_t n);
+
+typedef struct
+{
+  const char *name;
+  int (*supported) (void);
+  sin_fn_t fn;
+} sin_kernel_t;
+
+static void sin_scalar (const double *x, double *s, double *c, size_t n);
+static int sin_any (void);
+#ifdef CD_SIN_X86
+static void sin_avx2 (const double *x, double *s, double *c, size_t n);
+static void sin_avx512 (const double *x, double *s, double *c, size_t n);
+static int sin_has_avx2 (void);
+static int sin_has_avx512 (void);
+#endif
+static void sin_init (void);
+
+// Best first, the first supported kernel is used
+static const sin_kernel_t sin_kernels[] = {
+#ifdef CD_SIN_X86
+  {"avx512", sin_has_avx512, sin_avx512},
+  {"avx2", sin_has_avx2, sin_avx2},
+#endif
+  {"scalar", sin_any, sin_scalar},
+};
+
+#define SIN_REDUCE_MAX (1.0e6)	// k * SIN_PIO2_1 stays exact below
+#define SIN_CHECK_LEN (1U << 16)	// Arguments per checked range
+#define SIN_CHECK_REPS (64)	// Timed passes per kernel
+
+// pi/2 in three parts, the first two with 33 significant bits
+static const double sin_2_pi = 6.36619772367581382433e-01;
+static const double sin_pio2_1 = 1.57079632673412561417e+00;
+static const double sin_pio2_2 = 6.07710050650619224932e-11;
+static const double sin_pio2_3 = 2.02226624879595063154e-21;
+
+static const double sin_s[6] = {
+  -1.66666666666666324348e-01, 8.33333333332248946124e-03, -1.98412698298579493134e-04,
+  2.75573137070700676789e-06, -2.50507602534068634195e-08, 1.58969099521155010221e-10
+};
+
+static const double sin_c[6] = {
+  4.16666666666666019037e-02, -1.38888888888741095749e-03, 2.48015872894767294178e-05,
+  -2.75573143513906633035e-07, 2.08757232129817482790e-09, -1.13596475577881948265e-11
+};
+
+static pthread_once_t sin_once = PTHREAD_ONCE_INIT;
+static const sin_kernel_t *sin_sel;
+
+static void
+sin_scalar (const double *x, double *s, double *c, size_t n)
+{
+  for (size_t i = 0U; i < n; i++)
+    {
+      if (SIN_REDUCE_MAX < fabs (x[i]))
+	{
+	  if (s)
+	    {
+	      s[i] = sin (x[i]);
+	    }
+	  if (c)
+	    {
+	      c[i] = cos (x[i]);
+	    }
+	  continue;
+	}
+
+      const double k = nearbyint (x[i] * sin_2_pi);
+      const double r = ((x[i] - k * sin_pio2_1) - k * sin_pio2_2) - k * sin_pio2_3;
+      const double z = r * r;
+      const double ps = sin_s[0] + z * (sin_s[1] + z * (sin_s[2] + z * (sin_s[3] + z * (sin_s[4] + z * sin_s[5]))));
+      const double pc = sin_c[0] + z * (sin_c[1] + z * (sin_c[2] + z * (sin_c[3] + z * (sin_c[4] + z * sin_c[5]))));
+      const double sr = r + r * z * ps;
+      const double cr = 1.0 - 0.5 * z + z * z * pc;
+      const unsigned q = (unsigned) (long) k & 3U;
+
+      if (s)
+	{
+	  s[i] = (q & 1U) ? cr : sr;
+	  s[i] = (q & 2U) ? -s[i] : s[i];
+	}
+      if (c)
+	{
+	  c[i] = (q & 1U) ? sr : cr;
+	  c[i] = ((q + 1U) & 2U) ? -c[i] : c[i];
+	}
+    }
+}
+
+static int
+sin_any (void)
+{
+  return 1;
+}
+
+#ifdef CD_SIN_X86
+__attribute__((target ("avx2,fma")))
+static void
+sin_avx2 (const double *x, double *s, double *c, size_t n)
+{
+  const __m256d abs_mask = _mm256_castsi256_pd (_mm256_set1_epi64x (INT64_MAX));
+  const __m256d reduce_max = _mm256_set1_pd (SIN_REDUCE_MAX);
+  size_t i = 0U;
+
+  for (; i + 4U <= n; i += 4U)
+    {
+      const __m256d v = _mm256_loadu_pd (x + i);
+
+      if (_mm256_movemask_pd (_mm256_cmp_pd (_mm256_and_pd (v, abs_mask), reduce_max, _CMP_GT_OQ)))
+	{
+	  sin_scalar (x + i, s ? s + i : NULL, c ? c + i : NULL, 4U);
+	  continue;
+	}
+
+      const __m256d k = _mm256_round_pd (_mm256_mul_pd (v, _mm256_set1_pd (sin_2_pi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+      __m256d r = _mm256_fnmadd_pd (k, _mm256_set1_pd (sin_pio2_1), v);
+      r = _mm256_fnmadd_pd (k, _mm256_set1_pd (sin_pio2_2), r);
+      r = _mm256_fnmadd_pd (k, _mm256_set1_pd (sin_pio2_3), r);
+      const __m256d z = _mm256_mul_pd (r, r);
+
+      __m256d ps = _mm256_set1_pd (sin_s[5]);
+      __m256d pc = _mm256_set1_pd (sin_c[5]);
+      for (int ci = 4; ci >= 0; ci--)
+	{
+	  ps = _mm256_fmadd_pd (ps, z, _mm256_set1_pd (sin_s[ci]));
+	  pc = _mm256_fmadd_pd (pc, z, _mm256_set1_pd (sin_c[ci]));
+	}
+      const __m256d sr = _mm256_fmadd_pd (_mm256_mul_pd (r, z), ps, r);
+      const __m256d cr = _mm256_fmadd_pd (_mm256_mul_pd (z, z), pc, _mm256_fnmadd_pd (_mm256_set1_pd (0.5), z, _mm256_set1_pd (1.0)));
+
+      // Quadrant: odd swaps sin and cos, the sign comes from bit 1
+      const __m256i q = _mm256_cvtepi32_epi64 (_mm256_cvtpd_epi32 (k));
+      const __m256d odd = _mm256_castsi256_pd (_mm256_cmpeq_epi64 (_mm256_and_si256 (q, _mm256_set1_epi64x (1)), _mm256_set1_epi64x (1)));
+      if (s)
+	{
+	  const __m256d sign = _mm256_castsi256_pd (_mm256_slli_epi64 (_mm256_srli_epi64 (q, 1), 63));
+	  _mm256_storeu_pd (s + i, _mm256_xor_pd (_mm256_blendv_pd (sr, cr, odd), sign));
+	}
+      if (c)
+	{
+	  const __m256i q1 = _mm256_add_epi64 (q, _mm256_set1_epi64x (1));
+	  const __m256d sign = _mm256_castsi256_pd (_mm256_slli_epi64 (_mm256_srli_epi64 (q1, 1), 63));
+	  _mm256_storeu_pd (c + i, _mm256_xor_pd (_mm256_blendv_pd (cr, sr, odd), sign));
+	}
+    }
+  sin_scalar (x + i, s ? s + i : NULL, c ? c + i : NULL, n - i);
+}
+
+__attribute__((target ("avx512f")))
+static void
+sin_avx512 (const double *x, double *s, double *c, size_t n)
+{
+  const __m512d reduce_max = _mm512_set1_pd (SIN_REDUCE_MAX);
+  size_t i = 0U;
+
+  for (; i + 8U <= n; i += 8U)
+    {
+      const __m512d v = _mm512_loadu_pd (x + i);
+
+      if (_mm512_cmp_pd_mask (_mm512_abs_pd (v), reduce_max, _CMP_GT_OQ))
+	{
+	  sin_scalar (x + i, s ? s + i : NULL, c ? c + i : NULL, 8U);
+	  continue;
+	}
+
+      const __m512d k = _mm512_roundscale_pd (_mm512_mul_pd (v, _mm512_set1_pd (sin_2_pi)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+      __m512d r = _mm512_fnmadd_pd (k, _mm512_set1_pd (sin_pio2_1), v);
+      r = _mm512_fnmadd_pd (k, _mm512_set1_pd (sin_pio2_2), r);
+      r = _mm512_fnmadd_pd (k, _mm512_set1_pd (sin_pio2_3), r);
+      const __m512d z = _mm512_mul_pd (r, r);
+
+      __m512d ps = _mm512_set1_pd (sin_s[5]);
+      __m512d pc = _mm512_set1_pd (sin_c[5]);
+      for (int ci = 4; ci >= 0; ci--)
+	{
+	  ps = _mm512_fmadd_pd (ps, z, _mm512_set1_pd (sin_s[ci]));
+	  pc = _mm512_fmadd_pd (pc, z, _mm512_set1_pd (sin_c[ci]));
+	}
+      const __m512d sr = _mm512_fmadd_pd (_mm512_mul_pd (r, z), ps, r);
+      const __m512d cr = _mm512_fmadd_pd (_mm512_mul_pd (z, z), pc, _mm512_fnmadd_pd (_mm512_set1_pd (0.5), z, _mm512_set1_pd (1.0)));
+
+      const __m512i q = _mm512_cvtepi32_epi64 (_mm512_cvtpd_epi32 (k));
+      const __mmask8 odd = _mm512_test_epi64_mask (q, _mm512_set1_epi64 (1));
+      if (s)
+	{
+	  const __m512i sign = _mm512_slli_epi64 (_mm512_srli_epi64 (q, 1), 63);
+	  const __m512i val = _mm512_castpd_si512 (_mm512_mask_blend_pd (odd, sr, cr));
+	  _mm512_storeu_pd (s + i, _mm512_castsi512_pd (_mm512_xor_si512 (val, sign)));
+	}
+      if (c)
+	{
+	  const __m512i sign = _mm512_slli_epi64 (_mm512_srli_epi64 (_mm512_add_epi64 (q, _mm512_set1_epi64 (1)), 1), 63);
+	  const __m512i val = _mm512_castpd_si512 (_mm512_mask_blend_pd (odd, cr, sr));
+	  _mm512_storeu_pd (c + i, _mm512_castsi512_pd (_mm512_xor_si512 (val, sign)));
+	}
+    }
+  sin_scalar (x + i, s ? s + i : NULL, c ? c + i : NULL, n - i);
+}
+
+static int
+sin_has_avx2 (void)
+{
+  return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+}
+
+static int
+sin_has_avx512 (void)
+{
+  return __builtin_cpu_supports ("avx512f");
+}
+#endif
+
+static void
+sin_init (void)
+{
+  for (size_t ki = 0U; (NULL == sin_sel) && (ki < sizeof (sin_kernels) / sizeof (sin_kernels[0])); ki++)
+    {
+      if (sin_kernels[ki].supported ())
+	{
+	  sin_sel = &sin_kernels[ki];
+	}
+    }
+}
+
+void
+cd_sincos (const double *x, double *s, double *c, size_t n)
+{
+  pthread_once (&sin_once, sin_init);
+  sin_sel->fn (x, s, c, n);
+}
+
+/* Name of the i-th kernel the CPU supports, best first, NULL past the last */
+const char *
+cd_sincos_kernel (size_t i)
+{
+  const char *ret = NULL;
+
+  for (size_t ki = 0U; (NULL == ret) && (ki < sizeof (sin_kernels) / sizeof (sin_kernels[0])); ki++)
+    {
+      if (sin_kernels[ki].supported () && (0U == i--))
+	{
+	  ret = sin_kernels[ki].name;
+	}
+    }
+
+  return ret;
+}
+
+/* Select a kernel by name, NULL selects the best one again */
+void
+cd_sincos_use (const char *name)
+{
+  pthread_once (&sin_once, sin_init);
+  sin_sel = NULL;
+  for (size_t ki = 0U; name && (NULL == sin_sel) && (ki < sizeof (sin_kernels) / sizeof (sin_kernels[0])); ki++)
+    {
+      if (sin_kernels[ki].supported () && (0 == strcmp (name, sin_kernels[ki].name)))
+	{
+	  sin_sel = &sin_kernels[ki];
+	}
+    }
+  if (NULL == sin_sel)
+    {
+      sin_init ();
+    }
+}
+
+/*
+    Run every supported kernel over arguments up to the largest phases
+    the generators use and a few beyond the reduction limit, report the
+    largest error against libm and the throughput.
+*/
+int
+cd_sincos_check (FILE * out)
+{
+  int ret = CD_OK;
+  static const double ranges[] = { M_PI / 4.0, 2.0 * M_PI, 1.0e4, 3.0e5, 2.0 * SIN_REDUCE_MAX };
+  double *x = malloc (SIN_CHECK_LEN * sizeof (double));
+  double *s = malloc (SIN_CHECK_LEN * sizeof (double));
+  double *c = malloc (SIN_CHECK_LEN * sizeof (double));
+
+  if ((NULL == x) || (NULL == s) || (NULL == c))
+    {
+      fprintf (stderr, "Memory allocation error(sin): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  pthread_once (&sin_once, sin_init);
+  for (size_t ki = 0U; (CD_OK == ret) && (ki < sizeof (sin_kernels) / sizeof (sin_kernels[0])); ki++)
+    {
+      const sin_kernel_t *k = &sin_kernels[ki];
+      double err = 0.0;
+
+      if (!k->supported ())
+	{
+	  fprintf (out, "sin  %-6s: not supported\n", k->name);
+	  continue;
+	}
+
+      for (size_t ri = 0U; ri < sizeof (ranges) / sizeof (ranges[0]); ri++)
+	{
+	  for (size_t i = 0U; i < SIN_CHECK_LEN; i++)
+	    {
+	      x[i] = ranges[ri] * (2.0 * (double) i / (double) (SIN_CHECK_LEN - 1U) - 1.0);
+	    }
+	  k->fn (x, s, c, SIN_CHECK_LEN);
+	  for (size_t i = 0U; i < SIN_CHECK_LEN; i++)
+	    {
+	      err = fmax (err, fmax (fabs (s[i] - sin (x[i])), fabs (c[i] - cos (x[i]))));
+	    }
+	}
+
+      // A few ulp of 1.0, a polynomial or reduction bug is far beyond
+      if (1.0e-14 < err)
+	{
+	  fprintf (stderr, "sin %s: error %g against libm!\n\n", k->name, err);
+	  ret = CD_ERR_ARG;
+	}
+      else
+	{
+	  for (size_t i = 0U; i < SIN_CHECK_LEN; i++)
+	    {
+	      x[i] = 2.0 * M_PI * (double) i / (double) SIN_CHECK_LEN;
+	    }
+	  const double t0 = cd_clock ();
+	  for (int rep = 0; rep < SIN_CHECK_REPS; rep++)
+	    {
+	      k->fn (x, s, c, SIN_CHECK_LEN);
+	    }
+	  const double t = (cd_clock () - t0) / SIN_CHECK_REPS;
+	  fprintf (out, "sin  %-6s%s: ok, error %.1e, %8.1f M/s\n", k->name, (k == sin_sel) ? " (used)" : "", err,
+		   (double) SIN_CHECK_LEN / 1e6 / (t > 0.0 ? t : 1e-9));
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      const double t0 = cd_clock ();
+      for (size_t i = 0U; i < SIN_CHECK_LEN; i++)
+	{
+	  s[i] = sin (x[i]);
+	  c[i] = cos (x[i]);
+	}
+      const double t = cd_clock () - t0;
+      fprintf (out, "sin  libm  : %8.1f M/s\n", (double) SIN_CHECK_LEN / 1e6 / (t > 0.0 ? t : 1e-9));
+    }
+
+  free (c);
+  free (s);
+  free (x);
+
+  return ret;
+}
@@ -0,0 +1,386 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cdgen_int.h"
+
+static int sink_reserve (cd_sink_t * sink, size_t len);
+static const uint8_t *sink_packed (cd_sink_t * sink, cd_order_t order, const sample_t * sam, size_t len);
+static int sink_is_zero (const sample_t * sam, size_t len);
+static size_t out_offset (const cd_sink_out_t * out, size_t pos);
+static uint8_t *out_map (const cd_sink_out_t * out, size_t pos, size_t len);
+static int out_flush (cd_sink_out_t * out);
+static int out_fill (cd_sink_out_t * out, size_t offset, const uint8_t * pat, size_t pat_size, size_t count);
+static int out_repeat (cd_sink_t * sink, cd_sink_out_t * out, const sample_t * sam, size_t len, size_t count, int zero);
+static int out_zero (cd_sink_t * sink, cd_sink_out_t * out, size_t len);
+
+#define SINK_HOLE_MIN (65536U)	// Bytes, shorter zero runs are written
+
+int
+cd_sink_open (cd_sink_t * sink, cd_image_t * img, size_t img_num, size_t pos)
+{
+  memset (sink, 0, sizeof (*sink));
+  for (size_t oi = 0U; oi < img_num; oi++)
+    {
+      sink->out[oi].img = &img[oi];
+    }
+  sink->out_num = img_num;
+  sink->pos = pos;
+
+  return CD_OK;
+}
+
+int
+cd_sink_close (cd_sink_t * sink)
+{
+  int ret = CD_OK;
+
+  for (size_t oi = 0U; oi < sink->out_num; oi++)
+    {
+      int flush_ret = out_flush (&sink->out[oi]);
+      if (CD_OK == ret)
+	{
+	  ret = flush_ret;
+	}
+      free (sink->out[oi].blk);
+      sink->out[oi].blk = NULL;
+    }
+  free (sink->buf);
+  sink->buf = NULL;
+  sink->buf_len = 0U;
+
+  return ret;
+}
+
+/* Make room for len byteswapped samples, invalidates the buffer */
+static int
+sink_reserve (cd_sink_t * sink, size_t len)
+{
+  int ret = CD_OK;
+  int swap = 0;
+
+  for (size_t oi = 0U; oi < sink->out_num; oi++)
+    {
+      swap |= (CD_HOST_ORDER != sink->out[oi].img->order);
+    }
+
+  sink->buf_packed = 0;
+  if (swap && (sink->buf_len < len))
+    {
+      uint8_t *buf = realloc (sink->buf, len * cd_sample_size);
+      if (buf)
+	{
+	  sink->buf = buf;
+	  sink->buf_len = len;
+	}
+      else
+	{
+	  fprintf (stderr, "Memory allocation error(sink): %s!\n\n", strerror (errno));
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  return ret;
+}
+
+/* Samples in the given byte order, swapped on first use only */
+static const uint8_t *
+sink_packed (cd_sink_t * sink, cd_order_t order, const sample_t * sam, size_t len)
+{
+  const uint8_t *ret = (const uint8_t *) sam;
+
+  if (CD_HOST_ORDER != order)
+    {
+      if (!sink->buf_packed)
+	{
+	  cd_pack (order, sink->buf, sam, len);
+	  sink->buf_packed = 1;
+	}
+      ret = sink->buf;
+    }
+
+  return ret;
+}
+
+static int
+sink_is_zero (const sample_t * sam, size_t len)
+{
+  size_t i = 0U;
+
+  while ((i < len) && (0U == sam[i].s.l) && (0U == sam[i].s.r))
+    {
+      i++;
+    }
+
+  return i == len;
+}
+
+/* File offset of the sample at pos, behind the container header */
+static size_t
+out_offset (const cd_sink_out_t * out, size_t pos)
+{
+  return out->img->data_offset + pos * cd_sample_size;
+}
+
+/* Mapped image region for len samples at pos, NULL if not mapped */
+static uint8_t *
+out_map (const cd_sink_out_t * out, size_t pos, size_t len)
+{
+  uint8_t *ret = NULL;
+  const cd_image_t *img = out->img;
+
+  if (img->map)
+    {
+      const size_t samples = (img->size - img->data_offset) / cd_sample_size;
+      if ((pos <= samples) && (len <= samples - pos))
+	{
+	  ret = img->map + out_offset (out, pos);
+	}
+    }
+
+  return ret;
+}
+
+/* Write out the pending block */
+static int
+out_flush (cd_sink_out_t * out)
+{
+  int ret = CD_OK;
+
+  if (0U < out->blk_len)
+    {
+      ret = out->img->ops->write_at (out->img, out->blk_off, out->blk, out->blk_len);
+      out->blk_len = 0U;
+    }
+
+  return ret;
+}
+
+/*
+    Append count copies of a packed pattern at offset to the block.  The
+    first copy is placed per block, the rest are doubled from it with
+    memcpy.
+*/
+static int
+out_fill (cd_sink_out_t * out, size_t offset, const uint8_t * pat, size_t pat_size, size_t count)
+{
+  int ret = CD_OK;
+
+  if (NULL == out->blk)
+    {
+      if (0 != posix_memalign ((void **) &out->blk, 4096U, CD_SINK_BLOCK))
+	{
+	  fprintf (stderr, "Memory allocation error(sink): %s!\n\n", strerror (ENOMEM));
+	  out->blk = NULL;
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  if ((CD_OK == ret) && (0U < out->blk_len) && (out->blk_off + out->blk_len != offset))
+    {
+      ret = out_flush (out);
+    }
+  if (0U == out->blk_len)
+    {
+      out->blk_off = offset;
+    }
+
+  while ((CD_OK == ret) && (0U < count))
+    {
+      const size_t room = (CD_SINK_BLOCK - out->blk_len) / pat_size;
+
+      if (0U == room)
+	{
+	  ret = out_flush (out);
+	  out->blk_off = offset;
+	  continue;
+	}
+
+      const size_t n = (room < count) ? room : count;
+      uint8_t *dst = out->blk + out->blk_len;
+      size_t done = 1U;
+
+      memcpy (dst, pat, pat_size);
+      while (done < n)
+	{
+	  const size_t k = (done < n - done) ? done : (n - done);
+	  memcpy (dst + done * pat_size, dst, k * pat_size);
+	  done += k;
+	}
+      out->blk_len += n * pat_size;
+      offset += n * pat_size;
+      count -= n;
+    }
+
+  return ret;
+}
+
+static int
+out_repeat (cd_sink_t * sink, cd_sink_out_t * out, const sample_t * sam, size_t len, size_t count, int zero)
+{
+  int ret = CD_OK;
+  cd_image_t *img = out->img;
+  const size_t bufsize = len * cd_sample_size;
+  const size_t offset = out_offset (out, sink->pos);
+  uint8_t *map = out_map (out, sink->pos, len * count);
+
+  if (img->sparse && zero)
+    {
+      ret = out_zero (sink, out, len * count);
+    }
+  else if (map)
+    {
+      // Pack the first period in place, then double the run with memcpy
+      size_t done = 1U;
+
+      cd_pack (img->order, map, sam, len);
+      while (done < count)
+	{
+	  const size_t k = (done < count - done) ? done : (count - done);
+	  memcpy (map + done * bufsize, map, k * bufsize);
+	  done += k;
+	}
+    }
+  else if (img->ops->repeat && (1U < count) && (CD_SINK_BLOCK <= bufsize * count))
+    {
+      ret = out_flush (out);
+      if (CD_OK == ret)
+	{
+	  ret = img->ops->repeat (img, offset, sink_packed (sink, img->order, sam, len), bufsize, count);
+	}
+    }
+  else if (img->ops->copy && (1U < count))
+    {
+      // Write one period, then double the written run by copying it inside the image
+      size_t done = 1U;
+
+      ret = out_flush (out);
+      if (CD_OK == ret)
+	{
+	  ret = img->ops->write_at (img, offset, sink_packed (sink, img->order, sam, len), bufsize);
+	}
+      while ((CD_OK == ret) && (done < count))
+	{
+	  const size_t n = (done < count - done) ? done : (count - done);
+	  ret = img->ops->copy (img, offset, offset + done * bufsize, n * bufsize);
+	  done += n;
+	}
+    }
+  else if (bufsize <= CD_SINK_BLOCK / 2U)
+    {
+      ret = out_fill (out, offset, sink_packed (sink, img->order, sam, len), bufsize, count);
+    }
+  else
+    {
+      // Long period, already a large write on its own
+      const uint8_t *buf = sink_packed (sink, img->order, sam, len);
+
+      ret = out_flush (out);
+      for (size_t i = 0; (CD_OK == ret) && (i < count); i++)
+	{
+	  ret = img->ops->write_at (img, offset + i * bufsize, buf, bufsize);
+	}
+    }
+
+  // out_zero() has fed a zero run already
+  if ((CD_OK == ret) && !(img->sparse && zero) && (img->hasher || img->accurip || img->verify))
+    {
+      ret = cd_image_feed (img, offset, zero ? NULL : (map ? map : sink_packed (sink, img->order, sam, len)), bufsize, count);
+    }
+
+  return ret;
+}
+
+static int
+out_zero (cd_sink_t * sink, cd_sink_out_t * out, size_t len)
+{
+  int ret = CD_OK;
+  static const uint8_t zero[4] = { 0 };
+  const size_t offset = out_offset (out, sink->pos);
+
+  if (out_map (out, sink->pos, len))
+    {
+      // A mapped image starts zero filled
+      if (out->img->sparse)
+	{
+	  ret = cd_image_hole (out->img, offset, len * cd_sample_size);
+	}
+    }
+  else if (out->img->sparse && (SINK_HOLE_MIN <= len * cd_sample_size))
+    {
+      ret = out_flush (out);
+      if (CD_OK == ret)
+	{
+	  ret = cd_image_hole (out->img, offset, len * cd_sample_size);
+	}
+    }
+  else
+    {
+      ret = out_fill (out, offset, zero, sizeof (zero), len);
+    }
+
+  if (CD_OK == ret)
+    {
+      ret = cd_image_feed (out->img, offset, NULL, len * cd_sample_size, 1U);
+    }
+
+  return ret;
+}
+
+int
+cd_sink_write (cd_sink_t * sink, const sample_t * sam, size_t len)
+{
+  return cd_sink_repeat (sink, sam, len, 1U);
+}
+
+int
+cd_sink_repeat (cd_sink_t * sink, const sample_t * sam, size_t len, size_t count)
+{
+  int ret = sink_reserve (sink, len);
+  const int zero = sink_is_zero (sam, len);
+
+  for (size_t oi = 0U; (CD_OK == ret) && (oi < sink->out_num); oi++)
+    {
+      ret = out_repeat (sink, &sink->out[oi], sam, len, count, zero);
+    }
+  if (CD_OK == ret)
+    {
+      sink->pos += len * count;
+    }
+
+  return ret;
+}
+
+int
+cd_sink_zero (cd_sink_t * sink, size_t len)
+{
+  int ret = CD_OK;
+
+  for (size_t oi = 0U; (CD_OK == ret) && (oi < sink->out_num); oi++)
+    {
+      ret = out_zero (sink, &sink->out[oi], len);
+    }
+  if (CD_OK == ret)
+    {
+      sink->pos += len;
+    }
+
+  return ret;
+}
@@ -0,0 +1,465 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Disc spec file reader.  One directive per line, '#' starts a comment:
+
+      title "Disc title"
+      performer "Disc performer"
+      message "Disc message"
+      output basename
+      track <generator> key=value ...
+
+    Track keys are the cd_track_t fields: length, pregap, period, carrier,
+    steps, ratio, strips, seed, title, message, and index (repeated once
+    per INDEX 02 onwards).  Numbers accept 0x prefixes, values containing
+    blanks are double quoted.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "cdgen_int.h"
+
+#define SPEC_TOKENS_MAX (128U)
+
+struct cd_spec
+{
+  cd_disc_t disc;
+  cd_track_t *tracks;
+  size_t tracks_cap;
+  char *output;
+  char **strings;		// Owned copies of all text fields
+  size_t strings_num;
+};
+
+static char *spec_string (cd_spec_t * spec, const char *str);
+static size_t spec_tokenize (char *line, char **tok, size_t max);
+static int spec_number (const char *path, int line_no, const char *key, const char *val, size_t *num);
+static int spec_track (cd_spec_t * spec, const char *path, int line_no, char **tok, size_t tok_num);
+static int spec_line (cd_spec_t * spec, const char *path, int line_no, char *line);
+
+static char *
+spec_string (cd_spec_t * spec, const char *str)
+{
+  char *ret = NULL;
+  char **strings = realloc (spec->strings, (spec->strings_num + 1U) * sizeof (char *));
+
+  if (strings)
+    {
+      spec->strings = strings;
+      ret = strdup (str);
+      if (ret)
+	{
+	  spec->strings[spec->strings_num++] = ret;
+	}
+    }
+
+  if (NULL == ret)
+    {
+      fprintf (stderr, "Memory allocation error(spec): %s!\n\n", strerror (errno));
+    }
+
+  return ret;
+}
+
+/*
+    Split line in place into blank separated tokens.  Double quotes group
+    blanks into one token and are removed, a backslash inside quotes
+    escapes the next character.  Returns the number of tokens, max + 1
+    when the line holds more than max.
+*/
+static size_t
+spec_tokenize (char *line, char **tok, size_t max)
+{
+  size_t ret = 0U;
+  char *rd = line;
+
+  while (*rd)
+    {
+      while ((' ' == *rd) || ('\t' == *rd) || ('\r' == *rd) || ('\n' == *rd))
+	{
+	  rd++;
+	}
+      if (('\0' == *rd) || ('#' == *rd))
+	{
+	  break;
+	}
+      if (max == ret)
+	{
+	  ret++;
+	  break;
+	}
+
+      char *wr = rd;
+      int quoted = 0;
+
+      tok[ret++] = wr;
+      while (*rd && (quoted || !((' ' == *rd) || ('\t' == *rd) || ('\r' == *rd) || ('\n' == *rd) || ('#' == *rd))))
+	{
+	  if ('"' == *rd)
+	    {
+	      quoted = !quoted;
+	      rd++;
+	    }
+	  else
+	    {
+	      if (quoted && ('\\' == *rd) && rd[1])
+		{
+		  rd++;
+		}
+	      *wr++ = *rd++;
+	    }
+	}
+
+      const char end = *rd;
+      if (end && ('#' != end))
+	{
+	  rd++;
+	}
+      *wr = '\0';
+      if ('#' == end)
+	{
+	  break;
+	}
+    }
+
+  return ret;
+}
+
+/* Frame counts are bounded by the disc, so that no later sum can wrap */
+static int
+spec_number (const char *path, int line_no, const char *key, const char *val, size_t *num)
+{
+  int ret = CD_OK;
+  char *end = NULL;
+
+  errno = 0;
+  unsigned long long v = strtoull (val, &end, 0);
+  if ((0 != errno) || (end == val) || ('\0' != *end) || ('-' == *val) || ((size_t) v != v))
+    {
+      fprintf (stderr, "%s:%d: bad number for %s: \"%s\"\n", path, line_no, key, val);
+      ret = CD_ERR_ARG;
+    }
+  else if (((0 == strcmp (key, "length")) || (0 == strcmp (key, "pregap")) || (0 == strcmp (key, "index"))) && (cd_disc_frames_max < v))
+    {
+      fprintf (stderr, "%s:%d: %s of %s frames exceeds the Red Book disc maximum of %lu\n", path, line_no, key, val, cd_disc_frames_max);
+      ret = CD_ERR_ARG;
+    }
+  else
+    {
+      *num = (size_t) v;
+    }
+
+  return ret;
+}
+
+static int
+spec_track (cd_spec_t * spec, const char *path, int line_no, char **tok, size_t tok_num)
+{
+  int ret = CD_OK;
+  cd_track_t trk;
+  size_t *index = NULL;
+
+  memset (&trk, 0, sizeof (trk));
+  trk.seed = 0xb1e27b68;
+  trk.strips = 1U;
+
+  if ((2U > tok_num) || (CD_OK != cd_gen_find (tok[1], &trk.type)))
+    {
+      fprintf (stderr, "%s:%d: unknown generator \"%s\"\n", path, line_no, (2U > tok_num) ? "" : tok[1]);
+      ret = CD_ERR_ARG;
+    }
+
+  for (size_t ti = 2U; (CD_OK == ret) && (ti < tok_num); ti++)
+    {
+      char *key = tok[ti];
+      char *val = strchr (key, '=');
+      size_t num = 0U;
+
+      if (NULL == val)
+	{
+	  fprintf (stderr, "%s:%d: expected key=value, got \"%s\"\n", path, line_no, key);
+	  ret = CD_ERR_ARG;
+	  break;
+	}
+      *val++ = '\0';
+
+      if (0 == strcmp (key, "title"))
+	{
+	  trk.title = spec_string (spec, val);
+	  ret = trk.title ? CD_OK : CD_ERR_MEM;
+	}
+      else if (0 == strcmp (key, "message"))
+	{
+	  trk.message = spec_string (spec, val);
+	  ret = trk.message ? CD_OK : CD_ERR_MEM;
+	}
+      else if (CD_OK != (ret = spec_number (path, line_no, key, val, &num)))
+	{
+	  break;
+	}
+      else if (0 == strcmp (key, "length"))
+	{
+	  trk.length = num;
+	}
+      else if (0 == strcmp (key, "pregap"))
+	{
+	  trk.pregap = num;
+	}
+      else if (0 == strcmp (key, "period"))
+	{
+	  trk.period = num;
+	}
+      else if (0 == strcmp (key, "carrier"))
+	{
+	  trk.carrier = num;
+	}
+      else if (0 == strcmp (key, "steps"))
+	{
+	  trk.steps = num;
+	}
+      else if (0 == strcmp (key, "ratio"))
+	{
+	  trk.ratio = num;
+	}
+      else if (0 == strcmp (key, "strips"))
+	{
+	  trk.strips = num;
+	}
+      else if (0 == strcmp (key, "seed"))
+	{
+	  trk.seed = (unsigned int) num;
+	}
+      else if (0 == strcmp (key, "index"))
+	{
+	  size_t *grown = realloc (index, (trk.index_num + 1U) * sizeof (size_t));
+	  if (grown)
+	    {
+	      index = grown;
+	      index[trk.index_num++] = num;
+	    }
+	  else
+	    {
+	      fprintf (stderr, "Memory allocation error(spec): %s!\n\n", strerror (errno));
+	      ret = CD_ERR_MEM;
+	    }
+	}
+      else
+	{
+	  fprintf (stderr, "%s:%d: unknown track key \"%s\"\n", path, line_no, key);
+	  ret = CD_ERR_ARG;
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      if (spec->disc.tracks_num == spec->tracks_cap)
+	{
+	  const size_t cap = spec->tracks_cap ? (spec->tracks_cap * 2U) : 16U;
+	  cd_track_t *tracks = realloc (spec->tracks, cap * sizeof (cd_track_t));
+	  if (tracks)
+	    {
+	      spec->tracks = tracks;
+	      spec->tracks_cap = cap;
+	      spec->disc.tracks = tracks;
+	    }
+	  else
+	    {
+	      fprintf (stderr, "Memory allocation error(spec): %s!\n\n", strerror (errno));
+	      ret = CD_ERR_MEM;
+	    }
+	}
+    }
+
+  if (CD_OK == ret)
+    {
+      trk.index = index;
+      spec->tracks[spec->disc.tracks_num++] = trk;
+    }
+  else
+    {
+      free (index);
+    }
+
+  return ret;
+}
+
+static int
+spec_line (cd_spec_t * spec, const char *path, int line_no, char *line)
+{
+  int ret = CD_OK;
+  char *tok[SPEC_TOKENS_MAX];
+  const size_t tok_num = spec_tokenize (line, tok, SPEC_TOKENS_MAX);
+
+  if (0U == tok_num)
+    {
+      // Blank or comment
+    }
+  else if (SPEC_TOKENS_MAX < tok_num)
+    {
+      fprintf (stderr, "%s:%d: more than %u tokens\n", path, line_no, SPEC_TOKENS_MAX);
+      ret = CD_ERR_ARG;
+    }
+  else if (0 == strcmp (tok[0], "track"))
+    {
+      ret = spec_track (spec, path, line_no, tok, tok_num);
+    }
+  else if (2U != tok_num)
+    {
+      fprintf (stderr, "%s:%d: \"%s\" takes one value\n", path, line_no, tok[0]);
+      ret = CD_ERR_ARG;
+    }
+  else if (0 == strcmp (tok[0], "title"))
+    {
+      spec->disc.title = spec_string (spec, tok[1]);
+      ret = spec->disc.title ? CD_OK : CD_ERR_MEM;
+    }
+  else if (0 == strcmp (tok[0], "performer"))
+    {
+      spec->disc.performer = spec_string (spec, tok[1]);
+      ret = spec->disc.performer ? CD_OK : CD_ERR_MEM;
+    }
+  else if (0 == strcmp (tok[0], "message"))
+    {
+      spec->disc.message = spec_string (spec, tok[1]);
+      ret = spec->disc.message ? CD_OK : CD_ERR_MEM;
+    }
+  else if (0 == strcmp (tok[0], "output"))
+    {
+      spec->output = spec_string (spec, tok[1]);
+      ret = spec->output ? CD_OK : CD_ERR_MEM;
+    }
+  else
+    {
+      fprintf (stderr, "%s:%d: unknown directive \"%s\"\n", path, line_no, tok[0]);
+      ret = CD_ERR_ARG;
+    }
+
+  return ret;
+}
+
+cd_spec_t *
+cd_spec_load (const char *path)
+{
+  int ret = CD_OK;
+  cd_spec_t *spec = calloc (1U, sizeof (cd_spec_t));
+  FILE *in = fopen (path, "rt");
+  char *line = NULL;
+  size_t line_size = 0U;
+  int line_no = 0;
+
+  if (NULL == spec)
+    {
+      fprintf (stderr, "Memory allocation error(spec): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+  else if (NULL == in)
+    {
+      fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+  else
+    {
+      spec->disc.title = "";
+      spec->disc.performer = "";
+      spec->disc.message = "";
+    }
+
+  while ((CD_OK == ret) && (-1 != getline (&line, &line_size, in)))
+    {
+      line_no++;
+      ret = spec_line (spec, path, line_no, line);
+    }
+
+  if ((CD_OK == ret) && ferror (in))
+    {
+      fprintf (stderr, "Read error (%s): %s!\n\n", path, strerror (errno));
+      ret = CD_ERR_FILE;
+    }
+
+  if ((CD_OK == ret) && (0U == spec->disc.tracks_num))
+    {
+      fprintf (stderr, "%s: no tracks\n", path);
+      ret = CD_ERR_ARG;
+    }
+
+  // Default output name is the spec file name without directory and extension
+  if ((CD_OK == ret) && (NULL == spec->output))
+    {
+      const char *base = strrchr (path, '/');
+      base = base ? (base + 1) : path;
+      spec->output = spec_string (spec, base);
+      if (spec->output)
+	{
+	  char *ext = strrchr (spec->output, '.');
+	  if (ext && (ext != spec->output))
+	    {
+	      *ext = '\0';
+	    }
+	}
+      else
+	{
+	  ret = CD_ERR_MEM;
+	}
+    }
+
+  free (line);
+  if (in)
+    {
+      fclose (in);
+    }
+  if (CD_OK != ret)
+    {
+      cd_spec_free (spec);
+      spec = NULL;
+    }
+
+  return spec;
+}
+
+void
+cd_spec_free (cd_spec_t * spec)
+{
+  if (spec)
+    {
+      for (size_t ti = 0U; ti < spec->disc.tracks_num; ti++)
+	{
+	  free ((size_t *) spec->tracks[ti].index);
+	}
+      for (size_t si = 0U; si < spec->strings_num; si++)
+	{
+	  free (spec->strings[si]);
+	}
+      free (spec->strings);
+      free (spec->tracks);
+      free (spec);
+    }
+}
+
+const cd_disc_t *
+cd_spec_disc (const cd_spec_t * spec)
+{
+  return &spec->disc;
+}
+
+const char *
+cd_spec_output (const cd_spec_t * spec)
+{
+  return spec->output;
+}
@@ -0,0 +1,545 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+    Verification of an existing image against its spec.  The engine
+    renders the disc as usual into a writer that keeps nothing; every
+    run the sinks produce is compared with the same bytes of the image,
+    mapped read only, so nothing is written and no reference image is
+    needed.  Runs are compared as they come, from any thread.  Samples
+    that differ are counted per track (INDEX 00 to the next track), the
+    first one is kept for the report.  The compare uses SSE2 or AVX2
+    where the CPU has them, picked at first use, a portable loop
+    elsewhere; cd_verify_check() runs every kernel the CPU supports
+    against the portable one.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CD_VERIFY_X86 1
+#include <immintrin.h>
+#endif
+
+#include "cdgen_int.h"
+
+/* Differing samples of a and b, n samples, *first set to the first of them */
+typedef size_t (*verify_fn_t) (const uint8_t * a, const uint8_t * b, size_t n, size_t *first);
+
+typedef struct
+{
+  const char *name;
+  int (*supported) (void);
+  verify_fn_t fn;
+} verify_kernel_t;
+
+struct cd_verify
+{
+  const char *path;
+  const cd_plan_t *plan;
+  int fd;
+  const uint8_t *map;
+  size_t size;
+  size_t data_offset;
+  pthread_mutex_t lock;		// Guards everything below
+  size_t *diffs;		// Differing samples per track
+  size_t header;		// Differing header bytes
+  size_t first;			// First differing sample, SIZE_MAX if none
+  uint8_t expected[4];		// Its bytes as rendered
+  uint8_t found[4];		// and in the image
+};
+
+static size_t verify_scalar (const uint8_t * a, const uint8_t * b, size_t n, size_t *first);
+static int verify_any (void);
+#ifdef CD_VERIFY_X86
+static size_t verify_sse2 (const uint8_t * a, const uint8_t * b, size_t n, size_t *first);
+static size_t verify_avx2 (const uint8_t * a, const uint8_t * b, size_t n, size_t *first);
+static int verify_has_avx2 (void);
+#endif
+static void verify_init (void);
+static void verify_range (cd_verify_t * v, size_t pos, const uint8_t * buf, size_t len);
+static void verify_flip (uint8_t * buf, size_t d, size_t n);
+
+// Compare kernels, best first, the first supported one is used
+static const verify_kernel_t verify_kernels[] = {
+#ifdef CD_VERIFY_X86
+  {"avx2", verify_has_avx2, verify_avx2},
+  {"sse2", verify_any, verify_sse2},
+#endif
+  {"scalar", verify_any, verify_scalar},
+};
+
+#define VERIFY_ZEROS (65536U)	// Bytes of the zeros zero runs are compared with
+#define VERIFY_CHECK_REPS (32)	// Timed passes per kernel
+
+static pthread_once_t verify_once = PTHREAD_ONCE_INIT;
+static const verify_kernel_t *verify_sel;
+static const uint8_t verify_zeros[VERIFY_ZEROS];
+
+static size_t
+verify_scalar (const uint8_t * a, const uint8_t * b, size_t n, size_t *first)
+{
+  size_t ret = 0U;
+
+  *first = n;
+  for (size_t i = 0U; i < n; i++)
+    {
+      if (0 != memcmp (a + i * cd_sample_size, b + i * cd_sample_size, cd_sample_size))
+	{
+	  *first = ret ? *first : i;
+	  ret++;
+	}
+    }
+
+  return ret;
+}
+
+static int
+verify_any (void)
+{
+  return 1;
+}
+
+#ifdef CD_VERIFY_X86
+__attribute__((target ("sse2")))
+static size_t
+verify_sse2 (const uint8_t * a, const uint8_t * b, size_t n, size_t *first)
+{
+  size_t ret = 0U;
+  size_t i = 0U;
+
+  *first = n;
+  for (; i + 4U <= n; i += 4U)
+    {
+      const __m128i va = _mm_loadu_si128 ((const __m128i *) (a + i * cd_sample_size));
+      const __m128i vb = _mm_loadu_si128 ((const __m128i *) (b + i * cd_sample_size));
+      const unsigned int m = 0xfU & ~(unsigned int) _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (va, vb)));
+
+      if (0U != m)
+	{
+	  *first = ret ? *first : (i + (size_t) __builtin_ctz (m));
+	  ret += (size_t) __builtin_popcount (m);
+	}
+    }
+  if (i < n)
+    {
+      size_t tail_first;
+      const size_t tail = verify_scalar (a + i * cd_sample_size, b + i * cd_sample_size, n - i, &tail_first);
+
+      *first = (ret || !tail) ? *first : (i + tail_first);
+      ret += tail;
+    }
+
+  return ret;
+}
+
+/* Two vectors per step, the lanes are only looked at when the step differs */
+__attribute__((target ("avx2")))
+static size_t
+verify_avx2 (const uint8_t * a, const uint8_t * b, size_t n, size_t *first)
+{
+  size_t ret = 0U;
+  size_t i = 0U;
+
+  *first = n;
+  for (; i + 16U <= n; i += 16U)
+    {
+      const __m256i a0 = _mm256_loadu_si256 ((const __m256i *) (a + i * cd_sample_size));
+      const __m256i a1 = _mm256_loadu_si256 ((const __m256i *) (a + i * cd_sample_size + 32U));
+      const __m256i b0 = _mm256_loadu_si256 ((const __m256i *) (b + i * cd_sample_size));
+      const __m256i b1 = _mm256_loadu_si256 ((const __m256i *) (b + i * cd_sample_size + 32U));
+
+      if (!_mm256_testz_si256 (_mm256_or_si256 (_mm256_xor_si256 (a0, b0), _mm256_xor_si256 (a1, b1)), _mm256_set1_epi8 (-1)))
+	{
+	  const unsigned int m0 = 0xffU & ~(unsigned int) _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpeq_epi32 (a0, b0)));
+	  const unsigned int m1 = 0xffU & ~(unsigned int) _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpeq_epi32 (a1, b1)));
+	  const unsigned int m = m0 | (m1 << 8);
+
+	  *first = ret ? *first : (i + (size_t) __builtin_ctz (m));
+	  ret += (size_t) __builtin_popcount (m);
+	}
+    }
+  if (i < n)
+    {
+      size_t tail_first;
+      const size_t tail = verify_sse2 (a + i * cd_sample_size, b + i * cd_sample_size, n - i, &tail_first);
+
+      *first = (ret || !tail) ? *first : (i + tail_first);
+      ret += tail;
+    }
+
+  return ret;
+}
+
+static int
+verify_has_avx2 (void)
+{
+  return __builtin_cpu_supports ("avx2");
+}
+#endif
+
+static void
+verify_init (void)
+{
+  for (size_t ki = 0U; (NULL == verify_sel) && (ki < sizeof (verify_kernels) / sizeof (verify_kernels[0])); ki++)
+    {
+      if (verify_kernels[ki].supported ())
+	{
+	  verify_sel = &verify_kernels[ki];
+	}
+    }
+}
+
+/*
+    Map the image at path to compare the plan rendered into a size byte
+    image with data_offset header bytes against it.  NULL if it cannot be
+    read or has another size.
+*/
+cd_verify_t *
+cd_verify_open (const char *path, const cd_plan_t * plan, size_t size, size_t data_offset)
+{
+  cd_verify_t *ret = calloc (1U, sizeof (cd_verify_t));
+  size_t *diffs = calloc (plan->tracks_num ? plan->tracks_num : 1U, sizeof (size_t));
+  struct stat st;
+
+  pthread_once (&verify_once, verify_init);
+  if ((NULL == ret) || (NULL == diffs))
+    {
+      fprintf (stderr, "Memory allocation error(verify): %s!\n\n", strerror (errno));
+      free (diffs);
+      free (ret);
+      ret = NULL;
+    }
+  else
+    {
+      ret->path = path;
+      ret->plan = plan;
+      ret->size = size;
+      ret->data_offset = data_offset;
+      ret->diffs = diffs;
+      ret->first = SIZE_MAX;
+      pthread_mutex_init (&ret->lock, NULL);
+      ret->fd = open (path, O_RDONLY);
+
+      if ((0 > ret->fd) || (0 != fstat (ret->fd, &st)))
+	{
+	  fprintf (stderr, "Error opening %s: %s!\n\n", path, strerror (errno));
+	}
+      else if ((off_t) size != st.st_size)
+	{
+	  fprintf (stderr, "Verify %s: %lu bytes, %lu planned!\n\n", path, (unsigned long) st.st_size, (unsigned long) size);
+	}
+      else if (0U < size)
+	{
+	  void *addr = mmap (NULL, size, PROT_READ, MAP_SHARED, ret->fd, 0);
+
+	  if (MAP_FAILED == addr)
+	    {
+	      fprintf (stderr, "Error mapping %s: %s!\n\n", path, strerror (errno));
+	    }
+	  else
+	    {
+	      madvise (addr, size, MADV_SEQUENTIAL);
+	      ret->map = addr;
+	    }
+	}
+
+      if (NULL == ret->map)
+	{
+	  cd_verify_free (ret);
+	  ret = NULL;
+	}
+    }
+
+  return ret;
+}
+
+/* Compare len samples rendered for image sample pos, track by track */
+static void
+verify_range (cd_verify_t * v, size_t pos, const uint8_t * buf, size_t len)
+{
+  const cd_plan_t *plan = v->plan;
+  size_t lo = 0U;
+  size_t hi = plan->tracks_num;
+
+  // Last track beginning at or before pos
+  while (lo + 1U < hi)
+    {
+      const size_t mid = (lo + hi) / 2U;
+
+      if (plan->tracks[mid].begin <= pos)
+	{
+	  lo = mid;
+	}
+      else
+	{
+	  hi = mid;
+	}
+    }
+
+  for (size_t ti = lo; (0U < len) && (ti < plan->tracks_num); ti++)
+    {
+      const size_t end = (ti + 1U < plan->tracks_num) ? plan->tracks[ti + 1U].begin : plan->size;
+      const size_t n = (end - pos < len) ? (end - pos) : len;
+      const uint8_t *img = v->map + v->data_offset + pos * cd_sample_size;
+      size_t first;
+      const size_t diffs = verify_sel->fn (buf, img, n, &first);
+
+      if (0U < diffs)
+	{
+	  pthread_mutex_lock (&v->lock);
+	  v->diffs[ti] += diffs;
+	  if (pos + first < v->first)
+	    {
+	      v->first = pos + first;
+	      memcpy (v->expected, buf + first * cd_sample_size, cd_sample_size);
+	      memcpy (v->found, img + first * cd_sample_size, cd_sample_size);
+	    }
+	  pthread_mutex_unlock (&v->lock);
+	}
+
+      pos += n;
+      buf += n * cd_sample_size;
+      len -= n;
+    }
+}
+
+/* Compare count copies of len bytes at image offset, buf NULL for zeros */
+int
+cd_verify_feed (cd_verify_t * v, size_t offset, const uint8_t * buf, size_t len, size_t count)
+{
+  int ret = (offset + len * count <= v->size) ? CD_OK : CD_ERR_ARG;
+
+  if ((CD_OK == ret) && (offset < v->data_offset))
+    {
+      // Container header, written on its own
+      size_t diffs = 0U;
+
+      ret = (offset + len * count <= v->data_offset) ? CD_OK : CD_ERR_ARG;
+      for (size_t i = 0U; (CD_OK == ret) && (i < len * count); i++)
+	{
+	  diffs += ((buf ? buf[i % len] : 0U) != v->map[offset + i]);
+	}
+      pthread_mutex_lock (&v->lock);
+      v->header += diffs;
+      pthread_mutex_unlock (&v->lock);
+    }
+  else if ((CD_OK == ret) && ((0U != (offset - v->data_offset) % cd_sample_size) || (0U != len % cd_sample_size)))
+    {
+      ret = CD_ERR_ARG;
+    }
+  else
+    {
+      for (size_t k = 0U; (CD_OK == ret) && (k < count); k++)
+	{
+	  const size_t pos = (offset - v->data_offset + k * len) / cd_sample_size;
+
+	  for (size_t done = 0U; (NULL == buf) && (done < len); done += VERIFY_ZEROS)
+	    {
+	      const size_t n = (VERIFY_ZEROS < len - done) ? VERIFY_ZEROS : (len - done);
+
+	      verify_range (v, pos + done / cd_sample_size, verify_zeros, n / cd_sample_size);
+	    }
+	  if (buf)
+	    {
+	      verify_range (v, pos, buf, len / cd_sample_size);
+	    }
+	}
+    }
+
+  if (CD_ERR_ARG == ret)
+    {
+      fprintf (stderr, "Verify %s: run of %lu bytes at %lu outside the plan!\n\n", v->path, (unsigned long) (len * count), (unsigned long) offset);
+    }
+
+  return ret;
+}
+
+/*
+    Report the comparison to out: the first differing sample with its
+    track and position, then the differing samples of every track.
+    CD_ERR_DIFF if anything differs.
+*/
+int
+cd_verify_report (const cd_verify_t * v, FILE * out)
+{
+  int ret = ((SIZE_MAX == v->first) && (0U == v->header)) ? CD_OK : CD_ERR_DIFF;
+  const cd_plan_t *plan = v->plan;
+  size_t total = 0U;
+  size_t tracks = 0U;
+
+  for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+    {
+      total += v->diffs[ti];
+      tracks += (0U < v->diffs[ti]);
+    }
+
+  if (CD_OK == ret)
+    {
+      fprintf (out, "Verify %s: ok, %lu samples in %lu tracks\n", v->path, (unsigned long) plan->size, (unsigned long) plan->tracks_num);
+    }
+  else
+    {
+      fprintf (out, "Verify %s: differs, %lu samples in %lu of %lu tracks, %lu header bytes\n", v->path, (unsigned long) total,
+	       (unsigned long) tracks, (unsigned long) plan->tracks_num, (unsigned long) v->header);
+    }
+
+  if (SIZE_MAX != v->first)
+    {
+      const trk_index_t msf = calculate_index (v->first - v->first % cd_frame_size);
+      size_t ti = 0U;
+
+      while ((ti + 1U < plan->tracks_num) && (plan->tracks[ti + 1U].begin <= v->first))
+	{
+	  ti++;
+	}
+      fprintf (out, "First difference: sample %lu, track %02lu, at %02lu:%02lu:%02lu +%lu, expected %02x%02x%02x%02x, found %02x%02x%02x%02x\n",
+	       (unsigned long) v->first, (unsigned long) ti + 1UL, (unsigned long) msf.m, (unsigned long) msf.s, (unsigned long) msf.f,
+	       (unsigned long) (v->first % cd_frame_size), v->expected[0], v->expected[1], v->expected[2], v->expected[3], v->found[0],
+	       v->found[1], v->found[2], v->found[3]);
+    }
+
+  for (size_t ti = 0U; ti < plan->tracks_num; ti++)
+    {
+      fprintf (out, "Track %02lu: %lu differing samples\n", (unsigned long) ti + 1UL, (unsigned long) v->diffs[ti]);
+    }
+
+  return ret;
+}
+
+void
+cd_verify_free (cd_verify_t * v)
+{
+  if (v)
+    {
+      if (v->map)
+	{
+	  munmap ((void *) v->map, v->size);
+	}
+      if (0 <= v->fd)
+	{
+	  close (v->fd);
+	}
+      pthread_mutex_destroy (&v->lock);
+      free (v->diffs);
+      free (v);
+    }
+}
+
+/* Toggle a byte of sample d and of every 7th sample after it below n */
+static void
+verify_flip (uint8_t * buf, size_t d, size_t n)
+{
+  buf[d * cd_sample_size + d % cd_sample_size] ^= 0x40U;
+  for (size_t i = d + 7U; i < n; i += 7U)
+    {
+      buf[i * cd_sample_size + 3U] ^= 0x01U;
+    }
+}
+
+/*
+    Compare every supported kernel with the portable one over odd
+    lengths, misaligned buffers and scattered differences, then time
+    each on identical buffers.
+*/
+int
+cd_verify_check (FILE * out)
+{
+  int ret = CD_OK;
+  const size_t len = 1U << 20;
+  const size_t kernels_num = sizeof (verify_kernels) / sizeof (verify_kernels[0]);
+  uint8_t *a = malloc ((len + 1U) * cd_sample_size);
+  uint8_t *b = malloc ((len + 1U) * cd_sample_size);
+
+  if ((NULL == a) || (NULL == b))
+    {
+      fprintf (stderr, "Memory allocation error(verify): %s!\n\n", strerror (errno));
+      ret = CD_ERR_MEM;
+    }
+
+  for (size_t i = 0U; (CD_OK == ret) && (i < (len + 1U) * cd_sample_size); i++)
+    {
+      a[i] = (uint8_t) (i * 2654435761U >> 11);
+      b[i] = a[i];
+    }
+
+  pthread_once (&verify_once, verify_init);
+  for (size_t ki = 0U; (CD_OK == ret) && (ki < kernels_num); ki++)
+    {
+      const verify_kernel_t *kern = &verify_kernels[ki];
+
+      if (!kern->supported ())
+	{
+	  fprintf (out, "verify %-6s: not supported\n", kern->name);
+	  continue;
+	}
+
+      for (size_t n = 0U; (CD_OK == ret) && (n < 70U); n++)
+	{
+	  for (size_t skew = 0U; (CD_OK == ret) && (skew < 2U); skew++)
+	    {
+	      for (size_t d = 0U; (CD_OK == ret) && (d <= n); d += 1U + d / 3U)
+		{
+		  size_t ref_first, first;
+
+		  verify_flip (b + skew, d, n);
+		  const size_t ref = verify_scalar (a + skew, b + skew, n, &ref_first);
+		  if ((ref != kern->fn (a + skew, b + skew, n, &first)) || (ref_first != first))
+		    {
+		      fprintf (stderr, "verify %s: mismatch, %lu samples!\n\n", kern->name, (unsigned long) n);
+		      ret = CD_ERR_ARG;
+		    }
+		  verify_flip (b + skew, d, n);
+		}
+	    }
+	}
+
+      if (CD_OK == ret)
+	{
+	  size_t first;
+	  size_t diffs = 0U;
+	  const double t0 = cd_clock ();
+	  for (int rep = 0; rep < VERIFY_CHECK_REPS; rep++)
+	    {
+	      diffs += kern->fn (a, b, len, &first);
+	    }
+	  const double t = (cd_clock () - t0) / VERIFY_CHECK_REPS;
+	  if ((0U != diffs) || (len != first))
+	    {
+	      fprintf (stderr, "verify %s: mismatch, %lu samples!\n\n", kern->name, (unsigned long) len);
+	      ret = CD_ERR_ARG;
+	    }
+	  else
+	    {
+	      fprintf (out, "verify %-6s: ok %8.0f MB/s%s\n", kern->name, (double) (len * cd_sample_size) / 1e6 / (t > 0.0 ? t : 1e-9),
+		       (kern == verify_sel) ? " (used)" : "");
+	    }
+	}
+    }
+
+  free (b);
+  free (a);
+
+  return ret;
+}
@@ -0,0 +1,184 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "cdgen.h"
+
+static void usage (const char *prog);
+static int run_specs (cd_engine_t * engine, const char *out_dir, int first, int argc, char **argv);
+static int check_specs (int first, int argc, char **argv);
+
+static void
+usage (const char *prog)
+{
+  fprintf (stderr, "Incorrect arg.\nUsage: %s " CD_OPTIONS_USAGE " [-d outdir] [-b|--bench writer,...] spec [spec ...]\n       %s --check [spec ...]\n\n", prog, prog);
+}
+
+static int
+run_specs (cd_engine_t * engine, const char *out_dir, int first, int argc, char **argv)
+{
+  int ret = CD_OK;
+
+  // All discs share one engine, periods rendered for one are reused by the next
+  for (int ai = first; ai < argc; ai++)
+    {
+      int spec_ret = CD_OK;
+      cd_spec_t *spec = cd_spec_load (argv[ai]);
+      char *base_name = NULL;
+
+      if (spec)
+	{
+	  const char *output = cd_spec_output (spec);
+	  base_name = malloc ((out_dir ? strlen (out_dir) + 1U : 0U) + strlen (output) + 1U);
+	  if (base_name)
+	    {
+	      sprintf (base_name, "%s%s%s", out_dir ? out_dir : "", out_dir ? "/" : "", output);
+	      fprintf (stderr, "=====\n%s -> %s\n", argv[ai], base_name);
+	      spec_ret = cd_engine_generate (engine, cd_spec_disc (spec), base_name);
+	    }
+	  else
+	    {
+	      spec_ret = CD_ERR_MEM;
+	    }
+	}
+      else
+	{
+	  spec_ret = CD_ERR_ARG;
+	}
+
+      if (CD_OK != spec_ret)
+	{
+	  fprintf (stderr, "%s: generation failed (%d)\n", argv[ai], spec_ret);
+	  if (CD_OK == ret)
+	    {
+	      ret = spec_ret;
+	    }
+	}
+
+      free (base_name);
+      cd_spec_free (spec);
+    }
+
+  return ret;
+}
+
+static int
+check_specs (int first, int argc, char **argv)
+{
+  int ret = cd_self_check (stdout);
+
+  for (int ai = first; ai < argc; ai++)
+    {
+      cd_spec_t *spec = cd_spec_load (argv[ai]);
+      int spec_ret = spec ? cd_check_disc (cd_spec_disc (spec), stdout) : CD_ERR_ARG;
+
+      if (CD_OK != spec_ret)
+	{
+	  fprintf (stderr, "%s: check failed (%d)\n", argv[ai], spec_ret);
+	  if (CD_OK == ret)
+	    {
+	      ret = spec_ret;
+	    }
+	}
+      cd_spec_free (spec);
+    }
+
+  return ret;
+}
+
+/*
+    --check runs the built-in kernel checks, then compares the fast
+    render of every periodic track of the given specs with libm.
+    --bench renders the specs once per listed writer, each with a fresh
+    engine, and prints the time per generator and per image to stdout.
+*/
+int
+main (int argc, char **argv)
+{
+  int ret = CD_OK;
+  const char *out_dir = NULL;
+  char *bench = NULL;
+  int check = 0;
+  cd_options_t opt;
+  int key;
+  static const struct option long_opts[] = {
+    CD_OPTIONS_LONG,
+    {"outdir", required_argument, NULL, 'd'},
+    {"bench", required_argument, NULL, 'b'},
+    {"check", no_argument, NULL, 'K'},
+    {NULL, 0, NULL, 0}
+  };
+
+  memset (&opt, 0, sizeof (opt));
+  while ((CD_OK == ret) && (-1 != (key = getopt_long (argc, argv, CD_OPTIONS_SHORT "d:b:", long_opts, NULL))))
+    {
+      if ('d' == key)
+	{
+	  out_dir = optarg;
+	}
+      else if ('b' == key)
+	{
+	  bench = optarg;
+	}
+      else if ('K' == key)
+	{
+	  check = 1;
+	}
+      else
+	{
+	  ret = cd_option (&opt, key, optarg);
+	}
+    }
+
+  if ((CD_OK == ret) && check)
+    {
+      return check_specs (optind, argc, argv);
+    }
+
+  if ((CD_OK != ret) || (optind >= argc))
+    {
+      usage (argv[0]);
+      return CD_ERR_ARG;
+    }
+
+  char *save = NULL;
+  for (char *writer = bench ? strtok_r (bench, ",", &save) : NULL; writer && (CD_OK == ret); writer = strtok_r (NULL, ",", &save))
+    {
+      ret = cd_option (&opt, 'w', writer);
+      if (CD_OK == ret)
+	{
+	  cd_engine_t *engine = cd_engine_new (&opt);
+	  ret = engine ? run_specs (engine, out_dir, optind, argc, argv) : CD_ERR_MEM;
+	  if (engine)
+	    {
+	      cd_engine_report (engine, stdout);
+	    }
+	  cd_engine_free (engine);
+	}
+    }
+
+  if (NULL == bench)
+    {
+      cd_engine_t *engine = cd_engine_new (&opt);
+      ret = engine ? run_specs (engine, out_dir, optind, argc, argv) : CD_ERR_MEM;
+      cd_engine_free (engine);
+    }
+
+  return ret;
+}
@@ -0,0 +1,10 @@
+# gen1050cd: Four pure tones ten times step locked to FD
+title "Four pure tones ten times step locked to FD"
+performer "Tone generator"
+message "All tone frequencies are fraction of FD to avoid beating"
+
+track tone length=75000 period=42000 pregap=75
+track tone length=75000 period=4200
+track tone length=75000 period=420
+track tone length=75000 period=42
+track silence length=29250 strips=13
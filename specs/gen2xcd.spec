@@ -0,0 +1,22 @@
+# gen2xcd: Sixteen pure tones one octave step locked to FD
+title "Sixteen pure tones one octave step locked to FD"
+performer "Tone generator"
+message "All tone frequencies are fraction of FD to avoid beating"
+
+track tone length=0x4000 period=65536 pregap=75 title="Tone     0.672912597656250 Hz (0 dB)"
+track tone length=0x4000 period=32768 title="Tone     1.345825195312500 Hz (0 dB)"
+track tone length=0x4000 period=16384 title="Tone     2.691650390625000 Hz (0 dB)"
+track tone length=0x4000 period=8192 title="Tone     5.383300781250000 Hz (0 dB)"
+track tone length=0x4000 period=4096 title="Tone    10.766601562500000 Hz (0 dB)"
+track tone length=0x4000 period=2048 title="Tone    21.533203125000000 Hz (0 dB)"
+track tone length=0x4000 period=1024 title="Tone    43.066406250000000 Hz (0 dB)"
+track tone length=0x4000 period=512 title="Tone    86.132812500000000 Hz (0 dB)"
+track tone length=0x4000 period=256 title="Tone   172.265625000000000 Hz (0 dB)"
+track tone length=0x4000 period=128 title="Tone   344.531250000000000 Hz (0 dB)"
+track tone length=0x4000 period=64 title="Tone   689.062500000000000 Hz (0 dB)"
+track tone length=0x4000 period=32 title="Tone  1378.125000000000000 Hz (0 dB)"
+track tone length=0x4000 period=16 title="Tone  2756.250000000000000 Hz (0 dB)"
+track tone length=0x4000 period=8 title="Tone  5512.500000000000000 Hz (0 dB)"
+track tone length=0x4000 period=4 title="Tone 11025.000000000000000 Hz (0 dB)"
+track tone length=0x4000 period=2 title="Tone 22050.000000000000000 Hz (0 dB)"
+track silence length=6750 strips=3
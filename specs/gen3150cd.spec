@@ -0,0 +1,12 @@
+# gen3150cd: Six pure tones ten times step locked to FD
+title "Six pure tones ten times step locked to FD"
+performer "Tone generator"
+message "All tone frequencies are fraction of FD to avoid beating"
+
+track tone length=50000 period=1400000 pregap=75
+track tone length=50000 period=140000
+track tone length=50000 period=14000
+track tone length=50000 period=1400
+track tone length=50000 period=140
+track tone length=50000 period=14
+track silence length=29250 strips=13
@@ -0,0 +1,25 @@
+# genmisccd1: Miscellaneous waveforms
+title "Miscellaneous waveforms"
+performer "Waveform generator"
+message "All frequencies are fraction of FD to avoid beating"
+
+track noise length=22500 pregap=5 seed=0xb1e27b68
+track square length=4500 period=2450
+track square length=4500 period=490
+track square length=4500 period=98
+track pulse length=4500 period=2450
+track pulse length=4500 period=490
+track pulse length=4500 period=98
+track triangle length=0x8000 period=131072
+track triangle length=0x8000 period=32768
+track triangle length=0x8000 period=8192
+track triangle length=0x8000 period=2048
+track triangle length=0x8000 period=512
+track am_sine length=18000 period=8820 carrier=30
+track am_sine length=18000 period=8820 carrier=210
+track am_sine length=18000 period=8820 carrier=1470
+track am_triangle length=18000 period=8820 carrier=30
+track am_triangle length=18000 period=8820 carrier=210
+track am_triangle length=18000 period=8820 carrier=1470
+track fm_step length=25000 period=2500 steps=5 ratio=5
+track silence length=11250 strips=5